@@ -16,6 +16,7 @@ if glob.glob('_build/_bvh.cpy'):
     os.system('cd _build && ninja > /dev/null')
     sys.path.insert(0, str(build))  # Add the build path to sys.path for imports
     from _bvh import *
+    from _bvh_nd import *
     from _cookie_cutter import *
     from _expand_xforms import *
     from _xform_dist import *
@@ -27,8 +28,8 @@ if glob.glob('_build/_bvh.cpy'):
 
     sys.path.pop(0)  # Remove the build path so it doesn't interfere with import
 else:
-    # from hgeom._bvh_nd import *
     from hgeom._bvh import *
+    from hgeom._bvh_nd import *
     from hgeom._cookie_cutter import *
     from hgeom._expand_xforms import *
     from hgeom._xform_dist import *
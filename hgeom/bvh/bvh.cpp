@@ -6,7 +6,8 @@ cfg['include_dirs'] = [include, f'{include}/hgeom/extern']
 cfg['compiler_args'] = ['-std=c++17', '-w', '-Ofast']
 cfg['dependencies'] = ['../geom/primitive.hpp','../util/assertions.hpp',
 '../util/global_rng.hpp', 'bvh.hpp', 'bvh_algo.hpp', '../util/numeric.hpp',
-'../util/pybind_types.hpp']
+'../util/parallel.hpp', '../util/pybind_types.hpp', '../xbin/xbin.hpp',
+'../phmap/phmap.hpp']
 
 cfg['parallel'] = True
 
@@ -21,13 +22,19 @@ setup_pybind11(cfg)
 #include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
 
+#include "hgeom/phmap/phmap.hpp"
 #include "hgeom/util/Timer.hpp"
 #include "hgeom/util/assertions.hpp"
 #include "hgeom/util/global_rng.hpp"
 #include "hgeom/util/numeric.hpp"
+#include "hgeom/util/parallel.hpp"
 #include "hgeom/util/pybind_types.hpp"
+#include "hgeom/util/str.hpp"
 #include "hgeom/util/types.hpp"
+#include "hgeom/xbin/xbin.hpp"
 #include "iostream"
+#include <cstdio>
+#include <cstring>
 
 using namespace pybind11::literals;
 using namespace Eigen;
@@ -51,11 +58,119 @@ template <typename F> auto bounding_vol(PtIdx<F> v) {
   s.lb = s.ub = v.idx;
   return s;
 }
+
+// objects with a radius. distances between these are between the surfaces,
+// so may be negative when they overlap
+template <class F> struct SphIdx {
+  SphIdx() : pos(V3<F>::Zero()), rad(0), idx(0) {}
+  SphIdx(V3<F> v, F r, int i = 0) : pos(v), rad(r), idx(i) {}
+  V3<F> pos;
+  F rad;
+  int idx;
+};
+// segment a-b swept by a sphere of radius rad
+template <class F> struct CapIdx {
+  CapIdx() : a(V3<F>::Zero()), b(V3<F>::Zero()), rad(0), idx(0) {}
+  CapIdx(V3<F> a_, V3<F> b_, F r, int i = 0) : a(a_), b(b_), rad(r), idx(i) {}
+  V3<F> a, b;
+  F rad;
+  int idx;
+};
+template <typename F> auto bounding_vol(SphIdx<F> v) {
+  auto s = Sphere<F>(v.pos, v.rad);
+  s.lb = s.ub = v.idx;
+  return s;
+}
+template <typename F> auto bounding_vol(CapIdx<F> v) {
+  auto s = Sphere<F>((v.a + v.b) / 2, (v.b - v.a).norm() / 2 + v.rad);
+  s.lb = s.ub = v.idx;
+  return s;
+}
+template <typename F> SphIdx<F> operator*(X3<F> const &x, SphIdx<F> const &o) {
+  return SphIdx<F>(x * o.pos, o.rad, o.idx);
+}
+template <typename F> CapIdx<F> operator*(X3<F> const &x, CapIdx<F> const &o) {
+  return CapIdx<F>(x * o.a, x * o.b, o.rad, o.idx);
+}
+template <typename F> PtIdx<F> operator*(X3<F> const &x, PtIdx<F> const &o) {
+  return PtIdx<F>(x * o.pos, o.idx);
+}
+
+template <typename F> F point_seg_dist2(V3<F> p, V3<F> a, V3<F> b) {
+  V3<F> ab = b - a;
+  F len2 = ab.squaredNorm();
+  F t = len2 > 0 ? std::clamp<F>((p - a).dot(ab) / len2, 0, 1) : 0;
+  return (a + t * ab - p).squaredNorm();
+}
+// closest points of two segments, as in Ericson, Real-Time Collision
+// Detection 5.1.9
+template <typename F> F seg_seg_dist2(V3<F> p1, V3<F> q1, V3<F> p2, V3<F> q2) {
+  V3<F> d1 = q1 - p1, d2 = q2 - p2, r = p1 - p2;
+  F a = d1.squaredNorm(), e = d2.squaredNorm(), f = d2.dot(r);
+  F s = 0, t = 0;
+  if (a <= 0 && e <= 0) return r.squaredNorm();
+  if (a <= 0) {
+    t = std::clamp<F>(f / e, 0, 1);
+  } else {
+    F c = d1.dot(r);
+    if (e <= 0) {
+      s = std::clamp<F>(-c / a, 0, 1);
+    } else {
+      F b = d1.dot(d2), denom = a * e - b * b;
+      s = denom > 0 ? std::clamp<F>((b * f - c * e) / denom, 0, 1) : 0;
+      t = (b * s + f) / e;
+      if (t < 0) {
+        t = 0;
+        s = std::clamp<F>(-c / a, 0, 1);
+      } else if (t > 1) {
+        t = 1;
+        s = std::clamp<F>((b - c) / a, 0, 1);
+      }
+    }
+  }
+  return (p1 + d1 * s - p2 - d2 * t).squaredNorm();
+}
+
+// surface distance from the sphere cen, rad (a volume, or rad 0 for a point)
+// to an object
+template <typename F> F obj_dist(V3<F> cen, F rad, PtIdx<F> const &o) {
+  return (cen - o.pos).norm() - rad;
+}
+template <typename F> F obj_dist(V3<F> cen, F rad, SphIdx<F> const &o) {
+  return (cen - o.pos).norm() - rad - o.rad;
+}
+template <typename F> F obj_dist(V3<F> cen, F rad, CapIdx<F> const &o) {
+  return std::sqrt(point_seg_dist2(cen, o.a, o.b)) - rad - o.rad;
+}
+// surface distance between two objects in the same frame
+template <typename F, typename O>
+F obj_dist(PtIdx<F> const &o1, O const &o2) {
+  return obj_dist(o1.pos, F(0), o2);
+}
+template <typename F, typename O>
+F obj_dist(SphIdx<F> const &o1, O const &o2) {
+  return obj_dist(o1.pos, o1.rad, o2);
+}
+template <typename F> F obj_dist(CapIdx<F> const &o1, PtIdx<F> const &o2) {
+  return obj_dist(o2.pos, F(0), o1);
+}
+template <typename F> F obj_dist(CapIdx<F> const &o1, SphIdx<F> const &o2) {
+  return obj_dist(o2.pos, o2.rad, o1);
+}
+template <typename F> F obj_dist(CapIdx<F> const &o1, CapIdx<F> const &o2) {
+  return std::sqrt(seg_seg_dist2(o1.a, o1.b, o2.a, o2.b)) - o1.rad - o2.rad;
+}
 } // namespace Eigen
 
 template <typename F> using BVH = hgeom::bvh::SphereBVH<F, PtIdx<F>>;
 using BVHf = BVH<float>;
 using BVHd = BVH<double>;
+template <typename F>
+using LazyBVH = hgeom::bvh::LazySphereBVH<F, PtIdx<F>>;
+template <typename F>
+using DynamicBVH = hgeom::bvh::DynamicSphereBVH<F, PtIdx<F>>;
+template <typename F> using SphBVH = hgeom::bvh::SphereBVH<F, SphIdx<F>>;
+template <typename F> using CapBVH = hgeom::bvh::SphereBVH<F, CapIdx<F>>;
 
 namespace hgeom {
 namespace bvh {
@@ -100,35 +215,480 @@ template <typename F> Vx<int> bvh_vol_ubs(BVH<F> const &bvh) {
   return x;
 }
 
+/*
+iterates PtIdx objects read in place from an (N,3) coords buffer of any
+strides, over the selected rows, so the BVH fills its objs directly from the
+numpy (or memmap) data with no intermediate copy
+*/
+template <typename F, typename C> struct BVHCoordIter {
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = PtIdx<F>;
+  using difference_type = std::ptrdiff_t;
+  using pointer = PtIdx<F> *;
+  using reference = PtIdx<F>;
+  char const *ptr;
+  py::ssize_t s0, s1;
+  int const *sel;  // selected rows, or null for all rows
+  int const *ids;  // id per row, or null to use the row index
+  py::ssize_t ids_stride;
+  py::ssize_t i;
+  PtIdx<F> operator*() const {
+    py::ssize_t r = sel ? sel[i] : i;
+    char const *p = ptr + r * s0;
+    V3<F> v((F) * (C const *)p, (F) * (C const *)(p + s1),
+            (F) * (C const *)(p + 2 * s1));
+    int id = ids ? *(int const *)((char const *)ids + r * ids_stride) : (int)r;
+    return PtIdx<F>(v, id);
+  }
+  BVHCoordIter &operator++() {
+    ++i;
+    return *this;
+  }
+  BVHCoordIter operator++(int) {
+    auto tmp = *this;
+    ++i;
+    return tmp;
+  }
+  bool operator==(BVHCoordIter const &o) const { return i == o.i; }
+  bool operator!=(BVHCoordIter const &o) const { return i != o.i; }
+};
+
+/*
+optional on-disk cache of built BVH<F>, keyed by a hash of everything the
+tree is built from: the objects (converted coords and ids, in selection
+order), the full ids array, the dtype and the build options. set the cache
+directory with bvh_set_cache_dir or the HGEOM_BVH_CACHE environment
+variable. the directory must exist. files are written to a unique temp name
+and renamed into place, so concurrent jobs only ever see complete files, and
+any unreadable or mismatched file is treated as a miss
+*/
+struct BVHCache {
+  std::mutex mut;
+  std::string dir;
+  std::atomic<int64_t> nhit{0}, nmiss{0}, nwrite{0};
+  BVHCache() {
+    if (char const *env = std::getenv("HGEOM_BVH_CACHE")) dir = env;
+  }
+  std::string get_dir() {
+    std::lock_guard<std::mutex> lock(mut);
+    return dir;
+  }
+};
+inline BVHCache &bvh_cache() {
+  static BVHCache cache;
+  return cache;
+}
+inline std::string bvh_set_cache_dir(std::string dir) {
+  auto &cache = bvh_cache();
+  std::lock_guard<std::mutex> lock(cache.mut);
+  std::swap(cache.dir, dir);
+  return dir;
+}
+inline py::dict bvh_cache_stats() {
+  auto &cache = bvh_cache();
+  return py::dict("dir"_a = cache.get_dir(), "hits"_a = cache.nhit.load(),
+                  "misses"_a = cache.nmiss.load(),
+                  "writes"_a = cache.nwrite.load());
+}
+
+// 128 bit hash, two independently seeded splitmix64 chains
+struct BVHCacheKey {
+  uint64_t h[2] = {0x243f6a8885a308d3ull, 0x13198a2e03707344ull};
+  static uint64_t mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+  }
+  void add(uint64_t v) {
+    h[0] = mix(h[0] ^ v);
+    h[1] = mix(h[1] + v + 0x9e3779b97f4a7c15ull);
+  }
+  template <typename T> void add_bits(T v) {
+    static_assert(sizeof(T) <= sizeof(uint64_t), "add_bits");
+    uint64_t u = 0;
+    std::memcpy(&u, &v, sizeof(T));
+    add(u);
+  }
+  std::string hex() const {
+    char buf[33];
+    std::snprintf(buf, sizeof(buf), "%016llx%016llx", (unsigned long long)h[0],
+                  (unsigned long long)h[1]);
+    return buf;
+  }
+};
+
+/*
+ids of a vol's [lb, ub] are cut into 64 blocks of 2^shift ids
+*/
+inline int id_block_shift(int lb, int ub) {
+  uint32_t span = (uint32_t)((int64_t)ub - lb);
+  return span < 64 ? 0 : 26 - __builtin_clz(span);
+}
+/*
+sets each vol's lb/ub to the min/max obj id in its subtree and idblocks to
+the blocks of [lb, ub] its subtree holds ids in, a child's block may mark
+two parent blocks. done after build, as objs may get ids that need not
+follow the build order. children precede parents in vols
+*/
+template <typename Tree> void bvh_refit_id_bounds(Tree &bvh) {
+  int nvol = bvh.vols.size();
+  for (int i = 0; i < nvol; ++i) {
+    auto &v = bvh.vols[i];
+    v.lb = std::numeric_limits<int>::max();
+    v.ub = std::numeric_limits<int>::min();
+    for (int k = 0; k < 2; ++k) {
+      int c = bvh.child[2 * i + k];
+      int lb = c < nvol ? bvh.vols[c].lb : bvh.objs[c - nvol].idx;
+      int ub = c < nvol ? bvh.vols[c].ub : bvh.objs[c - nvol].idx;
+      v.lb = std::min(v.lb, lb);
+      v.ub = std::max(v.ub, ub);
+    }
+    int s = id_block_shift(v.lb, v.ub);
+    v.idblocks = 0;
+    for (int k = 0; k < 2; ++k) {
+      int c = bvh.child[2 * i + k];
+      if (c >= nvol) {
+        v.idblocks |= uint64_t(1) << ((bvh.objs[c - nvol].idx - v.lb) >> s);
+        continue;
+      }
+      auto const &cv = bvh.vols[c];
+      int cs = id_block_shift(cv.lb, cv.ub);
+      for (uint64_t b = cv.idblocks; b; b &= b - 1) {
+        int64_t blb = cv.lb + ((int64_t)__builtin_ctzll(b) << cs);
+        int64_t bub = std::min<int64_t>(cv.ub, blb + (int64_t(1) << cs) - 1);
+        for (int64_t j = (blb - v.lb) >> s; j <= (bub - v.lb) >> s; ++j)
+          v.idblocks |= uint64_t(1) << j;
+      }
+    }
+  }
+}
+
+// flat file layout: header, then objs (pos, idx), vols (cen, rad, lb, ub),
+// child, all native endian
+struct BVHCacheHeader {
+  char magic[8] = {'h', 'g', 'e', 'o', 'm', 'B', 'V', 'H'};
+  uint32_t version = 2, fsize = 0;
+  uint64_t key[2] = {0, 0};
+  int64_t nobj = 0, nvol = 0, nchild = 0;
+};
+template <typename F> struct BVHCacheIO {
+  std::vector<char> buf;
+  size_t pos = 0;
+  template <typename T> void put(T v) {
+    buf.resize(buf.size() + sizeof(T));
+    std::memcpy(buf.data() + buf.size() - sizeof(T), &v, sizeof(T));
+  }
+  template <typename T> T get() {
+    T v;
+    std::memcpy(&v, buf.data() + pos, sizeof(T));
+    pos += sizeof(T);
+    return v;
+  }
+  static size_t nbytes(BVHCacheHeader const &h) {
+    return sizeof(BVHCacheHeader) + h.nobj * (3 * sizeof(F) + sizeof(int32_t)) +
+           h.nvol * (4 * sizeof(F) + 2 * sizeof(int32_t)) +
+           h.nchild * sizeof(int32_t);
+  }
+};
+template <typename F>
+std::string bvh_cache_path(std::string const &dir, BVHCacheKey const &key) {
+  return dir + "/SphereBVH_" + short_str<F>() + "_" + key.hex() + ".bvh";
+}
+template <typename F>
+std::unique_ptr<BVH<F>> bvh_cache_load(std::string const &fname,
+                                       BVHCacheKey const &key) {
+  std::unique_ptr<std::FILE, int (*)(std::FILE *)> f(
+      std::fopen(fname.c_str(), "rb"), &std::fclose);
+  if (!f) return nullptr;
+  BVHCacheIO<F> io;
+  BVHCacheHeader h, ref;
+  if (std::fread(&h, sizeof(h), 1, f.get()) != 1) return nullptr;
+  if (std::memcmp(h.magic, ref.magic, 8) || h.version != ref.version ||
+      h.fsize != sizeof(F) || h.key[0] != key.h[0] || h.key[1] != key.h[1] ||
+      h.nobj < 0 || h.nvol < 0 || h.nchild != 2 * h.nvol)
+    return nullptr;
+  io.buf.resize(io.nbytes(h) - sizeof(h));
+  if (std::fread(io.buf.data(), 1, io.buf.size(), f.get()) != io.buf.size() ||
+      std::fgetc(f.get()) != EOF)
+    return nullptr;
+  auto bvh = std::make_unique<BVH<F>>();
+  bvh->objs.resize(h.nobj);
+  for (auto &o : bvh->objs) {
+    for (int j = 0; j < 3; ++j) o.pos[j] = io.template get<F>();
+    o.idx = io.template get<int32_t>();
+  }
+  bvh->vols.resize(h.nvol);
+  for (auto &v : bvh->vols) {
+    for (int j = 0; j < 3; ++j) v.cen[j] = io.template get<F>();
+    v.rad = io.template get<F>();
+    v.lb = io.template get<int32_t>();
+    v.ub = io.template get<int32_t>();
+  }
+  bvh->child.resize(h.nchild);
+  for (auto &c : bvh->child) c = io.template get<int32_t>();
+  bvh_refit_id_bounds(*bvh);
+  return bvh;
+}
 template <typename F>
-std::unique_ptr<BVH<F>> bvh_create(Mx<F> coords, Vx<bool> which, Vx<int> ids) {
-  if (coords.cols() != 3)
+bool bvh_cache_store(std::string const &fname, BVHCacheKey const &key,
+                     BVH<F> const &bvh) {
+  BVHCacheIO<F> io;
+  BVHCacheHeader h;
+  h.fsize = sizeof(F);
+  h.key[0] = key.h[0];
+  h.key[1] = key.h[1];
+  h.nobj = bvh.objs.size();
+  h.nvol = bvh.vols.size();
+  h.nchild = bvh.child.size();
+  io.buf.reserve(io.nbytes(h));
+  io.put(h);
+  for (auto const &o : bvh.objs) {
+    for (int j = 0; j < 3; ++j) io.put(o.pos[j]);
+    io.put((int32_t)o.idx);
+  }
+  for (auto const &v : bvh.vols) {
+    for (int j = 0; j < 3; ++j) io.put(v.cen[j]);
+    io.put(v.rad);
+    io.put((int32_t)v.lb);
+    io.put((int32_t)v.ub);
+  }
+  for (int c : bvh.child) io.put((int32_t)c);
+  // unique temp name in the same directory, then an atomic rename
+  std::random_device rd;
+  BVHCacheKey tmpkey;
+  tmpkey.add(rd());
+  tmpkey.add(rd());
+  tmpkey.add(std::hash<std::thread::id>()(std::this_thread::get_id()));
+  std::string tmp = fname + ".tmp" + tmpkey.hex();
+  std::FILE *f = std::fopen(tmp.c_str(), "wb");
+  if (!f) return false;
+  bool ok = std::fwrite(io.buf.data(), 1, io.buf.size(), f) == io.buf.size();
+  ok = std::fclose(f) == 0 && ok;
+  ok = ok && std::rename(tmp.c_str(), fname.c_str()) == 0;
+  if (!ok) std::remove(tmp.c_str());
+  return ok;
+}
+/*
+hashes the objects as the tree will see them, so any coords dtype, stride or
+selection that yields the same objects shares an entry. the ids array is
+hashed whole since vol lb/ub are mapped through it. the build options are
+the extra Tree constructor args
+*/
+template <typename F, typename Iter, typename... Args>
+BVHCacheKey bvh_cache_key(Iter beg, Iter end, py::array_t<int> const &ids,
+                          Args... args) {
+  BVHCacheKey key;
+  (key.add((uint64_t)args), ...);
+  key.add(BVHCacheHeader().version);
+  key.add(sizeof(F));
+  key.add(end.i - beg.i);
+  for (auto it = beg; it != end; ++it) {
+    PtIdx<F> o = *it;
+    for (int j = 0; j < 3; ++j) key.add_bits(o.pos[j]);
+    key.add_bits(o.idx);
+  }
+  key.add(ids.size());
+  for (py::ssize_t i = 0; i < ids.size(); ++i)
+    key.add_bits(*(int const *)((char const *)ids.data() + i * ids.strides(0)));
+  return key;
+}
+
+template <typename Tree, typename C, typename... Args>
+std::unique_ptr<Tree> bvh_create_from(py::array const &coords,
+                                      std::vector<int> const &sel, bool use_sel,
+                                      py::array_t<int> const &ids,
+                                      Args... args) {
+  using F = typename Tree::F;
+  using Iter = BVHCoordIter<F, C>;
+  int const *idptr = ids.size() ? ids.data() : nullptr;
+  py::ssize_t idstride = ids.size() ? ids.strides(0) : 0;
+  py::ssize_t n = use_sel ? sel.size() : coords.shape(0);
+  Iter beg{(char const *)coords.data(), coords.strides(0), coords.strides(1),
+           use_sel ? sel.data() : nullptr, idptr, idstride, 0};
+  Iter end = beg;
+  end.i = n;
+  constexpr bool cacheable = std::is_same<Tree, BVH<F>>::value;
+  std::string cachefile;
+  BVHCacheKey key;
+  if constexpr (cacheable) {
+    std::string dir = bvh_cache().get_dir();
+    if (!dir.empty()) {
+      key = bvh_cache_key<F>(beg, end, ids, args...);
+      cachefile = bvh_cache_path<F>(dir, key);
+      if (auto bvh = bvh_cache_load<F>(cachefile, key)) {
+        ++bvh_cache().nhit;
+        return bvh;
+      }
+      ++bvh_cache().nmiss;
+    }
+  }
+  auto bvh = std::make_unique<Tree>(beg, end, args...);
+  // LazyBVH and DynamicBVH bounds already hold ids and keep idblocks unknown
+  if constexpr (cacheable) {
+    bvh_refit_id_bounds(*bvh);
+    if (!cachefile.empty() && bvh_cache_store<F>(cachefile, key, *bvh))
+      ++bvh_cache().nwrite;
+  }
+  return bvh;
+}
+
+/*
+coords may be any (N,3) float32 or float64 array, contiguous or strided, and
+is read in place. other dtypes are converted first. which is either a bool
+mask of shape (N,) or an array of row indices to include, an empty which
+(like []) selects all rows. args are passed on to the Tree constructor
+*/
+template <typename Tree, typename... Args>
+std::unique_ptr<Tree> bvh_create_tree(py::array coords, py::object which,
+                                      py::array_t<int> ids, Args... args) {
+  using F = typename Tree::F;
+  if (coords.ndim() != 2 || coords.shape(1) != 3)
     throw std::runtime_error("argument 'coords' shape must be (N, 3)");
-  if (which.size() > 0 && which.size() != coords.rows())
-    throw std::runtime_error(
-        "argument 'which' shape must be (N,) matching coord shape");
-  if (ids.size() > 0 && ids.size() != coords.rows())
+  py::ssize_t n = coords.shape(0);
+  if (ids.size() > 0 && (ids.ndim() != 1 || ids.shape(0) != n))
     throw std::runtime_error(
         "argument 'idx' shape must be (N,) matching coord shape");
 
+  std::vector<int> sel;
+  bool use_sel = false;
+  if (!which.is_none()) {
+    auto w = py::array::ensure(which);
+    if (!w || w.ndim() != 1)
+      throw std::runtime_error("argument 'which' must be 1D");
+    // an empty which of any dtype (like []) means no selection
+    if (w.size() > 0) {
+      if (w.dtype().kind() == 'b') {
+        if (w.shape(0) != n)
+          throw std::runtime_error(
+              "argument 'which' shape must be (N,) matching coord shape");
+        use_sel = true;
+        auto maskarr = py::array_t<bool>::ensure(w);
+        auto mask = maskarr.template unchecked<1>();
+        for (py::ssize_t i = 0; i < n; ++i)
+          if (mask(i)) sel.push_back(i);
+      } else if (w.dtype().kind() == 'i' || w.dtype().kind() == 'u') {
+        use_sel = true;
+        auto idxarr = py::array_t<int64_t>::ensure(w);
+        auto idx = idxarr.template unchecked<1>();
+        sel.resize(idx.shape(0));
+        for (py::ssize_t i = 0; i < idx.shape(0); ++i) {
+          if (idx(i) < 0 || idx(i) >= n)
+            throw std::runtime_error("argument 'which' index out of range");
+          sel[i] = idx(i);
+        }
+      } else {
+        throw std::runtime_error(
+            "argument 'which' must be a bool mask or integer indices");
+      }
+    }
+  }
+
+  if (py::isinstance<py::array_t<float>>(coords)) {
+    py::gil_scoped_release release;
+    return bvh_create_from<Tree, float>(coords, sel, use_sel, ids, args...);
+  }
+  if (py::isinstance<py::array_t<double>>(coords)) {
+    py::gil_scoped_release release;
+    return bvh_create_from<Tree, double>(coords, sel, use_sel, ids, args...);
+  }
+  py::array conv = py::array_t<F, py::array::forcecast>::ensure(coords);
+  if (!conv) throw std::runtime_error("argument 'coords' must be numeric");
   py::gil_scoped_release release;
+  return bvh_create_from<Tree, F>(conv, sel, use_sel, ids, args...);
+}
+inline BoundMethod bvh_bound_method(std::string const &name) {
+  if (name == "welzl") return BoundMethod::welzl;
+  if (name == "merge") return BoundMethod::merge;
+  if (name == "ritter") return BoundMethod::ritter;
+  if (name == "central") return BoundMethod::central;
+  throw std::runtime_error(
+      "argument 'bound' must be one of welzl, merge, ritter, central");
+}
+/*
+bound selects how internal nodes are bounded, see BoundMethod. welzl gives the
+tightest tree, the others build faster at some cost in query time
+*/
+template <typename F>
+std::unique_ptr<BVH<F>> bvh_create(py::array coords, py::object which,
+                                   py::array_t<int> ids, std::string bound) {
+  return bvh_create_tree<BVH<F>>(coords, which, ids, bvh_bound_method(bound));
+}
+/*
+builds only the top levels levels of nodes (2^levels - 1 nodes), the rest is
+built as queries reach it. vol lb/ub are always the ids
+*/
+template <typename F>
+std::unique_ptr<LazyBVH<F>> bvh_create_lazy(py::array coords, py::object which,
+                                            py::array_t<int> ids, int levels) {
+  if (levels < 0) throw std::runtime_error("levels must be >= 0");
+  return bvh_create_tree<LazyBVH<F>>(coords, which, ids, levels);
+}
 
-  typedef std::vector<PtIdx<F>, aligned_allocator<PtIdx<F>>> Objs;
-  Objs holder;
-
-  for (int i = 0; i < coords.rows(); ++i) {
-    // std::cout << "mask " << i << " " << ptrw[i] << std::endl;
-    if (which.size() > 0 && !which[i])
-      continue;
-    int id = ids.size() == 0 ? i : ids[i];
-    holder.push_back(PtIdx<F>(coords.row(i), id));
-  }
-  auto bvh = std::make_unique<BVH<F>>(holder.begin(), holder.end());
-  if (ids.size())
-    for (auto &v : bvh->vols) {
-      v.lb = ids[v.lb];
-      v.ub = ids[v.ub];
-    }
+/*
+trees of objects with a radius. objects are built with their row as id, then
+objs are mapped through ids if given and vol lb/ub refit to the new ids
+*/
+template <typename Tree>
+void bvh_remap_ids(Tree &bvh, py::array_t<int> const &ids) {
+  if (ids.size() == 0) return;
+  auto id = ids.template unchecked<1>();
+  for (auto &o : bvh.objs) o.idx = id(o.idx);
+  bvh_refit_id_bounds(bvh);
+}
+template <typename F>
+void bvh_check_radii(py::array_t<F> const &radii, py::ssize_t n,
+                     py::array_t<int> const &ids) {
+  if (radii.ndim() != 1 || (radii.shape(0) != n && radii.shape(0) != 1))
+    throw std::runtime_error("argument 'radii' shape must be (N,) or (1,)");
+  if (ids.size() > 0 && (ids.ndim() != 1 || ids.shape(0) != n))
+    throw std::runtime_error(
+        "argument 'ids' shape must be (N,) matching coord shape");
+}
+template <typename F>
+std::unique_ptr<SphBVH<F>> bvh_create_spheres(py::array_t<F> coords,
+                                              py::array_t<F> radii,
+                                              py::array_t<int> ids,
+                                              std::string bound) {
+  if (coords.ndim() != 2 || coords.shape(1) != 3)
+    throw std::runtime_error("argument 'coords' shape must be (N, 3)");
+  py::ssize_t n = coords.shape(0);
+  bvh_check_radii(radii, n, ids);
+  auto c = coords.template unchecked<2>();
+  auto r = radii.template unchecked<1>();
+  bool onerad = radii.shape(0) == 1;
+  BoundMethod method = bvh_bound_method(bound);
+  py::gil_scoped_release release;
+  std::vector<SphIdx<F>, aligned_allocator<SphIdx<F>>> objs(n);
+  for (py::ssize_t i = 0; i < n; ++i)
+    objs[i] = SphIdx<F>(V3<F>(c(i, 0), c(i, 1), c(i, 2)), r(onerad ? 0 : i),
+                        (int)i);
+  auto bvh = std::make_unique<SphBVH<F>>(objs.begin(), objs.end(), method);
+  bvh_remap_ids(*bvh, ids);
+  return bvh;
+}
+template <typename F>
+std::unique_ptr<CapBVH<F>> bvh_create_capsules(py::array_t<F> ends,
+                                               py::array_t<F> radii,
+                                               py::array_t<int> ids,
+                                               std::string bound) {
+  if (ends.ndim() != 3 || ends.shape(1) != 2 || ends.shape(2) != 3)
+    throw std::runtime_error("argument 'ends' shape must be (N, 2, 3)");
+  py::ssize_t n = ends.shape(0);
+  bvh_check_radii(radii, n, ids);
+  auto e = ends.template unchecked<3>();
+  auto r = radii.template unchecked<1>();
+  bool onerad = radii.shape(0) == 1;
+  BoundMethod method = bvh_bound_method(bound);
+  py::gil_scoped_release release;
+  std::vector<CapIdx<F>, aligned_allocator<CapIdx<F>>> objs(n);
+  for (py::ssize_t i = 0; i < n; ++i)
+    objs[i] = CapIdx<F>(V3<F>(e(i, 0, 0), e(i, 0, 1), e(i, 0, 2)),
+                        V3<F>(e(i, 1, 0), e(i, 1, 1), e(i, 1, 2)),
+                        r(onerad ? 0 : i), (int)i);
+  auto bvh = std::make_unique<CapBVH<F>>(objs.begin(), objs.end(), method);
+  bvh_remap_ids(*bvh, ids);
   return bvh;
 }
 
@@ -148,7 +708,8 @@ template <typename F> struct BVHMinDistOne {
     return v;
   }
 };
-template <typename F> py::tuple bvh_min_dist_one(BVH<F> &bvh, V3<F> pt) {
+template <typename F, typename Tree = BVH<F>>
+py::tuple bvh_min_dist_one(Tree &bvh, V3<F> pt) {
   int idx;
   F result;
   {
@@ -187,6 +748,54 @@ template <typename F> struct BVHMinDistQuery {
     }
     return v;
   }
+  // objects with radii, distances are between surfaces
+  template <typename O>
+  F minimumOnVolumeObject(Sphere<F> vol1, O const &obj2) {
+    return obj_dist(vol1.cen, vol1.rad, bXa * obj2);
+  }
+  template <typename O>
+  F minimumOnObjectVolume(O const &obj1, Sphere<F> vol2) {
+    auto v = bXa * vol2;
+    return obj_dist(v.cen, v.rad, obj1);
+  }
+  template <typename O1, typename O2>
+  F minimumOnObjectObject(O1 const &obj1, O2 const &obj2) {
+    F v = obj_dist(obj1, bXa * obj2);
+    if (v < minval) {
+      minval = v;
+      idx1 = obj1.idx;
+      idx2 = obj2.idx;
+    }
+    return v;
+  }
+  // intersector interface so this can ride along in a BVIntersect traversal
+  // (see CompositeIntersector), descends only where a closer pair may exist
+  bool intersectVolumeVolume(Sphere<F> vol1, Sphere<F> vol2) {
+    return minimumOnVolumeVolume(vol1, vol2) < minval;
+  }
+  bool intersectVolumeObject(Sphere<F> vol1, PtIdx<F> obj2) {
+    return minimumOnVolumeObject(vol1, obj2) < minval;
+  }
+  bool intersectObjectVolume(PtIdx<F> obj1, Sphere<F> vol2) {
+    return minimumOnObjectVolume(obj1, vol2) < minval;
+  }
+  bool intersectObjectObject(PtIdx<F> obj1, PtIdx<F> obj2) {
+    minimumOnObjectObject(obj1, obj2);
+    return false;
+  }
+  template <typename O>
+  bool intersectVolumeObject(Sphere<F> vol1, O const &obj2) {
+    return minimumOnVolumeObject(vol1, obj2) < minval;
+  }
+  template <typename O>
+  bool intersectObjectVolume(O const &obj1, Sphere<F> vol2) {
+    return minimumOnObjectVolume(obj1, vol2) < minval;
+  }
+  template <typename O1, typename O2>
+  bool intersectObjectObject(O1 const &obj1, O2 const &obj2) {
+    minimumOnObjectObject(obj1, obj2);
+    return false;
+  }
 };
 
 template <typename F> py::tuple bvh_min_dist_fixed(BVH<F> &bvh1, BVH<F> &bvh2) {
@@ -194,23 +803,23 @@ template <typename F> py::tuple bvh_min_dist_fixed(BVH<F> &bvh1, BVH<F> &bvh2) {
   auto result = hgeom::bvh::BVMinimize(bvh1, bvh2, minimizer);
   return py::make_tuple(result, minimizer.idx1, minimizer.idx2);
 }
-template <typename F>
-py::tuple bvh_min_dist(BVH<F> &bvh1, BVH<F> &bvh2, M4<F> pos1, M4<F> pos2) {
+template <typename F, typename BVH1 = BVH<F>, typename BVH2 = BVH<F>>
+py::tuple bvh_min_dist(BVH1 &bvh1, BVH2 &bvh2, M4<F> pos1, M4<F> pos2, F eps) {
   int idx1, idx2;
   F result;
   {
     py::gil_scoped_release release;
     X3<F> x1(pos1), x2(pos2);
     BVHMinDistQuery<F> minimizer(x1.inverse() * x2);
-    result = hgeom::bvh::BVMinimize(bvh1, bvh2, minimizer);
+    result = hgeom::bvh::BVMinimize(bvh1, bvh2, minimizer, eps);
     idx1 = minimizer.idx1;
     idx2 = minimizer.idx2;
   }
   return py::make_tuple(result, idx1, idx2);
 }
-template <typename F>
-py::tuple bvh_min_dist_vec(BVH<F> &bvh1, BVH<F> &bvh2, py::array_t<F> pos1,
-                           py::array_t<F> pos2) {
+template <typename F, typename BVH1 = BVH<F>, typename BVH2 = BVH<F>>
+py::tuple bvh_min_dist_vec(BVH1 &bvh1, BVH2 &bvh2, py::array_t<F> pos1,
+                           py::array_t<F> pos2, F eps) {
   auto x1 = xform_py_to_eigen(pos1);
   auto x2 = xform_py_to_eigen(pos2);
   if (x1.size() != x2.size())
@@ -225,12 +834,12 @@ py::tuple bvh_min_dist_vec(BVH<F> &bvh1, BVH<F> &bvh2, py::array_t<F> pos1,
     idx2->resize(x1.size());
     for (size_t i = 0; i < x1.size(); ++i) {
       BVHMinDistQuery<F> minimizer(x1[i].inverse() * x2[i]);
-      (*mindis)[i] = hgeom::bvh::BVMinimize(bvh1, bvh2, minimizer);
+      (*mindis)[i] = hgeom::bvh::BVMinimize(bvh1, bvh2, minimizer, eps);
       (*idx1)[i] = minimizer.idx1;
       (*idx2)[i] = minimizer.idx2;
     }
   }
-  return py::make_tuple(*mindis, *idx1, *idx2);
+  return py::make_tuple(std::move(*mindis), std::move(*idx1), std::move(*idx2));
 }
 template <typename F> F naive_min_dist_fixed(BVH<F> &bvh1, BVH<F> &bvh2) {
   F mind2 = 9e9;
@@ -274,6 +883,22 @@ template <typename F> struct BVHIsectQuery {
     result |= isect;
     return isect;
   }
+  // objects with radii, rad is the allowed gap between surfaces
+  template <typename O>
+  bool intersectVolumeObject(Sphere<F> vol1, O const &obj2) {
+    return obj_dist(vol1.cen, vol1.rad, bXa * obj2) < rad;
+  }
+  template <typename O>
+  bool intersectObjectVolume(O const &obj1, Sphere<F> vol2) {
+    auto v = bXa * vol2;
+    return obj_dist(v.cen, v.rad, obj1) < rad;
+  }
+  template <typename O1, typename O2>
+  bool intersectObjectObject(O1 const &obj1, O2 const &obj2) {
+    bool isect = obj_dist(obj1, bXa * obj2) < rad;
+    result |= isect;
+    return isect;
+  }
   F rad = 0, rad2 = 0;
   bool result = false;
   Xform bXa = Xform::Identity();
@@ -296,16 +921,16 @@ bool naive_isect_fixed(BVH<F> &bvh1, BVH<F> &bvh2, F thresh) {
   }
   return false;
 }
-template <typename F>
-bool bvh_isect(BVH<F> &bvh1, BVH<F> &bvh2, M4<F> pos1, M4<F> pos2, F mindist) {
+template <typename F, typename BVH1 = BVH<F>, typename BVH2 = BVH<F>>
+bool bvh_isect(BVH1 &bvh1, BVH2 &bvh2, M4<F> pos1, M4<F> pos2, F mindist) {
   py::gil_scoped_release release;
   X3<F> x1(pos1), x2(pos2);
   BVHIsectQuery<F> query(mindist, x1.inverse() * x2);
   hgeom::bvh::BVIntersect(bvh1, bvh2, query);
   return query.result;
 }
-template <typename F>
-Vx<bool> bvh_isect_vec(BVH<F> &bvh1, BVH<F> &bvh2, py::array_t<F> pos1,
+template <typename F, typename BVH1 = BVH<F>, typename BVH2 = BVH<F>>
+Vx<bool> bvh_isect_vec(BVH1 &bvh1, BVH2 &bvh2, py::array_t<F> pos1,
                        py::array_t<F> pos2, F mindist) {
   auto x1 = xform_py_to_eigen(pos1);
   auto x2 = xform_py_to_eigen(pos2);
@@ -351,6 +976,103 @@ bool naive_isect(BVH<F> &bvh1, BVH<F> &bvh2, M4<F> pos1, M4<F> pos2,
   return false;
 }
 
+// root sphere of a bvh, rad -1 if empty. a one object tree has no vols
+template <typename Tree> Sphere<typename Tree::F> bvh_root_sphere(Tree &bvh) {
+  using F = typename Tree::F;
+  if (!bvh.vols.empty()) return bvh.getVolume(bvh.getRootIndex());
+  if (bvh.objs.empty()) return Sphere<F>(V3<F>::Zero(), -1);
+  return bounding_vol(bvh.objs[0]);
+}
+
+/*
+candidate body pairs i < j whose placed root spheres are within mindist, by
+sweep and prune along the principal axis of the sphere centers
+*/
+template <typename F>
+std::vector<std::pair<int, int>> sweep_and_prune(
+    std::vector<Sphere<F>, aligned_allocator<Sphere<F>>> const &sph,
+    F mindist) {
+  std::vector<std::pair<int, int>> out;
+  int n = sph.size();
+  if (n < 2) return out;
+  V3<F> mean = V3<F>::Zero();
+  for (auto const &s : sph) mean += s.cen;
+  mean /= n;
+  Matrix<F, 3, 3> cov = Matrix<F, 3, 3>::Zero();
+  for (auto const &s : sph) cov += (s.cen - mean) * (s.cen - mean).transpose();
+  JacobiSVD<Matrix<F, 3, 3>> svd(cov, ComputeFullU);
+  V3<F> axis = svd.matrixU().col(0);
+
+  std::vector<std::pair<F, int>> lo(n);
+  std::vector<F> hi(n);
+  for (int i = 0; i < n; ++i) {
+    F p = sph[i].cen.dot(axis), r = sph[i].rad + mindist / 2;
+    lo[i] = {p - r, i};
+    hi[i] = p + r;
+  }
+  std::sort(lo.begin(), lo.end());
+  std::vector<int> active;
+  for (auto const &l : lo) {
+    int i = l.second;
+    if (sph[i].rad < 0) continue;
+    // drop intervals that end before this one starts
+    active.erase(std::remove_if(active.begin(), active.end(),
+                                [&](int j) { return hi[j] < l.first; }),
+                 active.end());
+    for (int j : active)
+      if (sph[i].signdis(sph[j]) < mindist)
+        out.emplace_back(std::min(i, j), std::max(i, j));
+    active.push_back(i);
+  }
+  std::sort(out.begin(), out.end());
+  return out;
+}
+
+/*
+intersection test between every pair of placed bodies. bodies is a list of
+bvhs, or a single bvh used for all poses. returns the (M,2) intersecting
+body index pairs i < j. candidate pairs come from a sweep and prune over the
+root spheres, the two tree tests on them run in parallel
+*/
+template <typename F>
+py::array_t<int32_t> bvh_isect_bodies(py::list bodies, py::array_t<F> poses,
+                                      F mindist, int nthread) {
+  auto x = xform_py_to_eigen(poses);
+  int n = x.size();
+  if (bodies.size() != 1 && (int)bodies.size() != n)
+    throw std::runtime_error("need one body, or one per pose");
+  std::vector<BVH<F> *> bvh(n);
+  for (int i = 0; i < n; ++i)
+    bvh[i] = bodies[bodies.size() == 1 ? 0 : i].template cast<BVH<F> *>();
+  std::vector<int32_t> pairs;
+  {
+    py::gil_scoped_release release;
+    std::vector<Sphere<F>, aligned_allocator<Sphere<F>>> sph(n);
+    for (int i = 0; i < n; ++i) {
+      sph[i] = bvh_root_sphere(*bvh[i]);
+      sph[i].cen = x[i] * sph[i].cen;
+    }
+    auto cand = sweep_and_prune(sph, mindist);
+    std::vector<char> hit(cand.size(), 0);
+    parallel_for(
+        cand.size(),
+        [&](size_t k) {
+          int i = cand[k].first, j = cand[k].second;
+          BVHIsectQuery<F> query(mindist, x[i].inverse() * x[j]);
+          hgeom::bvh::BVIntersect(*bvh[i], *bvh[j], query);
+          hit[k] = query.result;
+        },
+        nthread);
+    for (size_t k = 0; k < cand.size(); ++k) {
+      if (!hit[k]) continue;
+      pairs.push_back(cand[k].first);
+      pairs.push_back(cand[k].second);
+    }
+  }
+  py::ssize_t npair = pairs.size() / 2;
+  return vector_to_py(std::move(pairs), {npair, 2});
+}
+
 /////////////////////////////////////////////////////////
 
 template <typename F> struct BVHIsectFixedRangeQuery {
@@ -437,7 +1159,7 @@ py::tuple bvh_isect_fixed_range_vec(BVH<F> &bvh1, BVH<F> &bvh2,
       clashid(i, 1) = query.clashidB;
     }
   }
-  return py::make_tuple(out, clashid);
+  return py::make_tuple(std::move(out), std::move(clashid));
 }
 
 ///////////////////////////////////////////////////
@@ -512,8 +1234,12 @@ template <typename F> struct BVHIsectRange {
     // PtIdx = point index; a sphere + index #
     // B is side getting trimmed
     // if lowest res# in BV > current ub or ub res# in BV < current lb; BV is
-    // done; don't do anything. basically out of range
-    if (vol1.lb % nasym1 > ub || vol1.ub % nasym1 < lb)
+    // done; don't do anything. basically out of range. only valid when the
+    // ids of the BV don't wrap around nasym1, else its ids mod nasym1 are not
+    // the range [lb % nasym1, ub % nasym1]
+    bool nowrap = vol1.ub - vol1.lb < nasym1 &&
+                  vol1.lb % nasym1 <= vol1.ub % nasym1;
+    if (nowrap && (vol1.lb % nasym1 > ub || vol1.ub % nasym1 < lb))
       return false;
     return vol1.signdis(bXa * obj2.pos) < rad;
   }
@@ -532,10 +1258,21 @@ template <typename F> struct BVHIsectRange {
     // << std::endl;
     // if intersecting, trim more
     if (isect) {
-      if (obj1.idx % nasym1 < mid)
-        lb = std::max(obj1.idx % nasym1 + 1, lb);
-      else
-        ub = std::min(obj1.idx % nasym1 - 1, ub);
+      // remember the pairs that set lb and ub, neighboring poses check them
+      // first (see warm_start)
+      if (obj1.idx % nasym1 < mid) {
+        if (obj1.idx % nasym1 + 1 > lb) {
+          lb = obj1.idx % nasym1 + 1;
+          witness[0] = obj1;
+          witness[1] = obj2;
+          has_witness_lb = true;
+        }
+      } else if (obj1.idx % nasym1 - 1 < ub) {
+        ub = obj1.idx % nasym1 - 1;
+        witness[2] = obj1;
+        witness[3] = obj2;
+        has_witness_ub = true;
+      }
       // if trimming too much, give up
       bool ok = (ub >= min_ub) && (lb <= max_lb) && ((ub - lb) >= minrange);
       if (!ok) {
@@ -546,6 +1283,24 @@ template <typename F> struct BVHIsectRange {
     }
     return false;
   }
+  // resets the trim and seeds it with the witness pairs of another query.
+  // the trim only depends on which pairs clash, so this never changes the
+  // result, but a tight starting range prunes most of the traversal. returns
+  // true if the seeds alone already exceed maxtrim
+  bool warm_start(BVHIsectRange<F> const &prev) {
+    lb = 0;
+    ub = nasym1 - 1;
+    has_witness_lb = has_witness_ub = false;
+    if (prev.has_witness_lb &&
+        intersectObjectObject(prev.witness[0], prev.witness[1]))
+      return true;
+    if (prev.has_witness_ub &&
+        intersectObjectObject(prev.witness[2], prev.witness[3]))
+      return true;
+    return false;
+  }
+  PtIdx<F> witness[4];
+  bool has_witness_lb = false, has_witness_ub = false;
 };
 template <typename F>
 /*
@@ -589,7 +1344,7 @@ py::tuple bvh_isect_range(BVH<F> &bvh1, BVH<F> &bvh2, py::array_t<F> pos1,
       (*ub)[i] = query.ub;
     }
   }
-  return py::make_tuple(*lb, *ub);
+  return py::make_tuple(std::move(*lb), std::move(*ub));
 }
 template <typename F>
 py::tuple bvh_isect_range_single(BVH<F> &bvh1, BVH<F> &bvh2, M4<F> pos1,
@@ -610,6 +1365,63 @@ py::tuple bvh_isect_range_single(BVH<F> &bvh1, BVH<F> &bvh2, M4<F> pos1,
   }
   return py::make_tuple(lb, ub);
 }
+/*
+parallel bvh_isect_range for scans. poses are split into contiguous chunks,
+one chunk per task; inside a chunk each pose is warm started from the
+witness pairs of the previous pose, so similar neighboring poses begin with
+nearly their final trim. results match bvh_isect_range for any nasym1, as
+the trim does not depend on traversal order (BVHIsectRange only prunes a BV
+on ids mod nasym1 when its id range does not wrap). also returns the
+number of poses that exit early on maxtrim (lb = ub = -1) and how many of
+those exits came from the seeds alone, without a traversal
+*/
+template <typename F>
+py::tuple bvh_isect_range_warm(BVH<F> &bvh1, BVH<F> &bvh2, py::array_t<F> pos1,
+                               py::array_t<F> pos2, F mindist, int maxtrim = -1,
+                               int maxtrim_lb = -1, int maxtrim_ub = -1,
+                               int nasym1 = -1, int nthread = 0,
+                               int chunk = 0) {
+  auto x1 = xform_py_to_eigen(pos1);
+  auto x2 = xform_py_to_eigen(pos2);
+  if (x1.size() != x2.size() && x1.size() != 1 && x2.size() != 1)
+    throw std::runtime_error("pos1 and pos2 must have same length");
+  size_t n = std::max(x1.size(), x2.size());
+  Vx<int> lb(n), ub(n);
+  std::atomic<int> nexit(0), nseedexit(0);
+  {
+    py::gil_scoped_release release;
+    if (nasym1 < 0)
+      nasym1 = bvh_max_id(bvh1) + 1;
+    BVHIsectRange<F> proto(mindist, X3<F>::Identity(), bvh_max_id(bvh1), -1,
+                           maxtrim, maxtrim_lb, maxtrim_ub, nasym1);
+    nthread = resolve_nthread(nthread, n);
+    if (chunk <= 0)
+      chunk = std::max<size_t>(16, n / (8 * nthread));
+    size_t nchunk = (n + chunk - 1) / chunk;
+    parallel_for(
+        nchunk,
+        [&](size_t ichunk) {
+          BVHIsectRange<F> prev = proto, query = proto;
+          size_t end = std::min(n, (ichunk + 1) * chunk);
+          for (size_t i = ichunk * chunk; i < end; ++i) {
+            size_t i1 = x1.size() == 1 ? 0 : i;
+            size_t i2 = x2.size() == 1 ? 0 : i;
+            query.bXa = x1[i1].inverse() * x2[i2];
+            if (query.warm_start(prev))
+              ++nseedexit;
+            else
+              hgeom::bvh::BVIntersect(bvh1, bvh2, query);
+            if (query.lb == -1) ++nexit;
+            lb[i] = query.lb;
+            ub[i] = query.ub;
+            std::swap(prev, query);
+          }
+        },
+        nthread, 1);
+  }
+  return py::make_tuple(std::move(lb), std::move(ub), nexit.load(),
+                        nseedexit.load());
+}
 
 template <typename F>
 py::tuple naive_bvh_isect_range(BVH<F> &bvh1, BVH<F> &bvh2, M4<F> pos1,
@@ -633,7 +1445,7 @@ py::tuple naive_bvh_isect_range(BVH<F> &bvh1, BVH<F> &bvh2, M4<F> pos1,
     }
   }
   // return py::make_tuple(query.lb, query.ub);
-  return py::make_tuple(lb, ub);
+  return py::make_tuple(std::move(lb), std::move(ub));
 }
 
 template <typename F> struct BVMinAxis {
@@ -708,6 +1520,134 @@ Vx<F> bvh_slide_vec(BVH<F> &bvh1, BVH<F> &bvh2, py::array_t<F> pos1,
   return slides;
 }
 
+/*
+batched slide, every pose along every direction. dirns is (D,3) in the
+global frame, output is (N, D). one traversal per pose x direction, spread
+over threads
+*/
+template <typename F>
+Mx<F> bvh_slide_multi_vec(BVH<F> &bvh1, BVH<F> &bvh2, py::array_t<F> pos1,
+                          py::array_t<F> pos2, F rad, Mx<F> dirns,
+                          int nthread = 0) {
+  auto x1 = xform_py_to_eigen(pos1);
+  auto x2 = xform_py_to_eigen(pos2);
+  if (x1.size() != x2.size() && x1.size() != 1 && x2.size() != 1)
+    throw std::runtime_error("pos1 and pos2 must have same len");
+  if (dirns.cols() != 3) throw std::runtime_error("dirns must be shape (D,3)");
+  for (int k = 0; k < dirns.rows(); ++k)
+    if (dirns.row(k).norm() < 0.0001)
+      throw std::runtime_error("Slide direction must not be 0");
+  size_t n = std::max(x1.size(), x2.size()), ndir = dirns.rows();
+  Mx<F> slides(n, ndir);
+  {
+    py::gil_scoped_release release;
+    parallel_for(
+        n * ndir,
+        [&](size_t j) {
+          size_t i = j / ndir, k = j % ndir;
+          size_t i1 = x1.size() == 1 ? 0 : i;
+          size_t i2 = x2.size() == 1 ? 0 : i;
+          X3<F> x1inv = x1[i1].inverse();
+          V3<F> local_dir = x1inv.rotation() * dirns.row(k).transpose();
+          BVMinAxis<F> query(local_dir, x1inv * x2[i2], rad);
+          slides(i, k) = hgeom::bvh::BVMinimize(bvh1, bvh2, query);
+        },
+        nthread);
+  }
+  return slides;
+}
+
+/*
+rotational slide: body1 turns about an axis by a positive (right handed)
+angle until it first touches body2. the minimum is the contact angle in
+[0, 2pi), 0 if already in contact, 9e9 if no contact in a full turn. a point
+on a circle comes within R of a fixed point when cos(theta - phi) >= c, which
+gives the entry angle in closed form. spheres are swept with their radius
+added to R, so a volume's entry angle never exceeds that of anything inside
+it and BVMinimize can prune on it
+*/
+template <typename F> struct BVMinRotAxis {
+  using Scalar = F;
+  using Xform = X3<F>;
+  Xform bXa = Xform::Identity();
+  F rad;
+  V3<F> axis, cen;
+  BVMinRotAxis(V3<F> a, V3<F> c, Xform x, F r)
+      : axis(a), cen(c), bXa(x), rad(r) {
+    if (axis.norm() < 0.0001)
+      throw std::runtime_error("Rotation axis must not be 0");
+    axis.normalize();
+  }
+  F minimumOnVolumeVolume(Sphere<F> r1, Sphere<F> r2) {
+    return get_angle(r1.cen, bXa * r2.cen, r1.rad + r2.rad + 2 * rad);
+  }
+  F minimumOnVolumeObject(Sphere<F> r, PtIdx<F> v) {
+    return get_angle(r.cen, bXa * v.pos, r.rad + 2 * rad);
+  }
+  F minimumOnObjectVolume(PtIdx<F> v, Sphere<F> r) {
+    return get_angle(v.pos, bXa * r.cen, r.rad + 2 * rad);
+  }
+  F minimumOnObjectObject(PtIdx<F> a, PtIdx<F> b) {
+    return get_angle(a.pos, bXa * b.pos, 2 * rad);
+  }
+  F get_angle(V3<F> moving, V3<F> fixed, F contact) {
+    V3<F> p = moving - cen, q = fixed - cen;
+    V3<F> ppar = p.dot(axis) * axis, pperp = p - ppar;
+    F rho = pperp.norm();
+    F k = (ppar - q).squaredNorm() + rho * rho;
+    F contact2 = contact * contact;
+    if (rho < epsilon2<F>()) return k <= contact2 ? 0 : 9e9;
+    V3<F> u = pperp / rho, v = axis.cross(u);
+    F a = u.dot(q), b = v.dot(q), m = std::sqrt(a * a + b * b);
+    if (m < epsilon2<F>()) return k <= contact2 ? 0 : 9e9;
+    // distance^2 = k - 2 rho m cos(theta - phi)
+    F c = (k - contact2) / (2 * rho * m);
+    if (c > 1) return 9e9;
+    if (k - 2 * rho * a <= contact2) return 0; // touching at theta = 0
+    F entry = std::atan2(b, a) - std::acos(std::max<F>(c, -1));
+    entry = std::fmod(entry, F(2 * M_PI));
+    return entry < 0 ? entry + F(2 * M_PI) : entry;
+  }
+};
+
+template <typename F>
+F bvh_slide_rot(BVH<F> &bvh1, BVH<F> &bvh2, M4<F> pos1, M4<F> pos2, F rad,
+                V3<F> axis, V3<F> cen) {
+  py::gil_scoped_release release;
+  X3<F> x1(pos1), x2(pos2);
+  X3<F> x1inv = x1.inverse();
+  BVMinRotAxis<F> query(x1inv.rotation() * axis, x1inv * cen, x1inv * x2, rad);
+  return hgeom::bvh::BVMinimize(bvh1, bvh2, query);
+}
+template <typename F>
+Vx<F> bvh_slide_rot_vec(BVH<F> &bvh1, BVH<F> &bvh2, py::array_t<F> pos1,
+                        py::array_t<F> pos2, F rad, V3<F> axis, V3<F> cen,
+                        int nthread = 0) {
+  auto x1 = xform_py_to_eigen(pos1);
+  auto x2 = xform_py_to_eigen(pos2);
+  if (x1.size() != x2.size() && x1.size() != 1 && x2.size() != 1)
+    throw std::runtime_error("pos1 and pos2 must have same len");
+  if (axis.norm() < 0.0001)
+    throw std::runtime_error("Rotation axis must not be 0");
+  size_t n = std::max(x1.size(), x2.size());
+  Vx<F> angles(n);
+  {
+    py::gil_scoped_release release;
+    parallel_for(
+        n,
+        [&](size_t i) {
+          size_t i1 = x1.size() == 1 ? 0 : i;
+          size_t i2 = x2.size() == 1 ? 0 : i;
+          X3<F> x1inv = x1[i1].inverse();
+          BVMinRotAxis<F> query(x1inv.rotation() * axis, x1inv * cen,
+                                x1inv * x2[i2], rad);
+          angles[i] = hgeom::bvh::BVMinimize(bvh1, bvh2, query);
+        },
+        nthread);
+  }
+  return angles;
+}
+
 template <typename F> struct BVHCountPairs {
   using Scalar = F;
   using Xform = X3<F>;
@@ -730,10 +1670,24 @@ template <typename F> struct BVHCountPairs {
       nout++;
     return false;
   }
+  template <typename O>
+  bool intersectVolumeObject(Sphere<F> vol1, O const &obj2) {
+    return obj_dist(vol1.cen, vol1.rad, bXa * obj2) < mindis;
+  }
+  template <typename O>
+  bool intersectObjectVolume(O const &obj1, Sphere<F> vol2) {
+    auto v = bXa * vol2;
+    return obj_dist(v.cen, v.rad, obj1) < mindis;
+  }
+  template <typename O1, typename O2>
+  bool intersectObjectObject(O1 const &obj1, O2 const &obj2) {
+    if (obj_dist(obj1, bXa * obj2) < mindis) nout++;
+    return false;
+  }
 };
 
-template <typename F>
-int bvh_count_pairs(BVH<F> &bvh1, BVH<F> &bvh2, M4<F> pos1, M4<F> pos2,
+template <typename F, typename BVH1 = BVH<F>, typename BVH2 = BVH<F>>
+int bvh_count_pairs(BVH1 &bvh1, BVH2 &bvh2, M4<F> pos1, M4<F> pos2,
                     F maxdist) {
   py::gil_scoped_release release;
   X3<F> x1(pos1), x2(pos2);
@@ -742,8 +1696,8 @@ int bvh_count_pairs(BVH<F> &bvh1, BVH<F> &bvh2, M4<F> pos1, M4<F> pos2,
   hgeom::bvh::BVIntersect(bvh1, bvh2, query);
   return query.nout;
 }
-template <typename F>
-Vx<int> bvh_count_pairs_vec(BVH<F> &bvh1, BVH<F> &bvh2, py::array_t<F> pos1,
+template <typename F, typename BVH1 = BVH<F>, typename BVH2 = BVH<F>>
+Vx<int> bvh_count_pairs_vec(BVH1 &bvh1, BVH2 &bvh2, py::array_t<F> pos1,
                             py::array_t<F> pos2, F maxdist) {
   auto x1 = xform_py_to_eigen(pos1);
   auto x2 = xform_py_to_eigen(pos2);
@@ -762,21 +1716,320 @@ Vx<int> bvh_count_pairs_vec(BVH<F> &bvh1, BVH<F> &bvh2, py::array_t<F> pos1,
   }
   return npair;
 }
-template <typename F> struct BVHCollectPairs {
+/*
+counts pairs into distance bins in one traversal. edges2 holds the squared
+bin edges, ascending; pruning uses the largest edge. a pair with distance d
+lands in bin k when edges[k] <= d < edges[k+1]
+*/
+template <typename F> struct BVHCountPairsHist {
   using Scalar = F;
   using Xform = X3<F>;
-  F mindis = 0.0, mindis2 = 0.0;
+  F maxdis = 0.0;
   Xform bXa = Xform::Identity();
-  int32_t *out;
-  int nout = 0, maxout = -1;
-  bool overflow = false;
-  BVHCollectPairs(F r, Xform x, int32_t *ptr, int mx)
-      : mindis(r), bXa(x), out(ptr), maxout(mx), mindis2(r * r) {}
+  F const *edges2;
+  int nedge;
+  int64_t *counts;
+  BVHCountPairsHist(Xform x, F const *e2, int ne, int64_t *c)
+      : bXa(x), edges2(e2), nedge(ne), counts(c),
+        maxdis(std::sqrt(e2[ne - 1])) {}
   bool intersectVolumeVolume(Sphere<F> vol1, Sphere<F> vol2) {
-    return vol1.signdis(bXa * vol2) < mindis;
+    return vol1.signdis(bXa * vol2) < maxdis;
   }
   bool intersectVolumeObject(Sphere<F> vol1, PtIdx<F> obj2) {
-    return vol1.signdis(bXa * obj2.pos) < mindis;
+    return vol1.signdis(bXa * obj2.pos) < maxdis;
+  }
+  bool intersectObjectVolume(PtIdx<F> obj1, Sphere<F> vol2) {
+    return (bXa * vol2).signdis(obj1.pos) < maxdis;
+  }
+  bool intersectObjectObject(PtIdx<F> obj1, PtIdx<F> obj2) {
+    F d2 = (obj1.pos - bXa * obj2.pos).squaredNorm();
+    if (d2 < edges2[nedge - 1] && d2 >= edges2[0]) {
+      int k = std::upper_bound(edges2, edges2 + nedge, d2) - edges2 - 1;
+      ++counts[k];
+    }
+    return false;
+  }
+};
+
+template <typename F>
+Mx<int64_t> bvh_count_pairs_hist(BVH<F> &bvh1, BVH<F> &bvh2,
+                                 py::array_t<F> pos1, py::array_t<F> pos2,
+                                 Vx<F> bin_edges, int nthread = 0) {
+  auto x1 = xform_py_to_eigen(pos1);
+  auto x2 = xform_py_to_eigen(pos2);
+  if (x1.size() != x2.size() && x1.size() != 1 && x2.size() != 1)
+    throw std::runtime_error("pos1 and pos2 must have same length");
+  int nedge = bin_edges.size();
+  if (nedge < 2) throw std::runtime_error("bin_edges must have length >= 2");
+  for (int i = 1; i < nedge; ++i)
+    if (bin_edges[i] <= bin_edges[i - 1])
+      throw std::runtime_error("bin_edges must be strictly increasing");
+  if (bin_edges[0] < 0) throw std::runtime_error("bin_edges must be >= 0");
+  py::gil_scoped_release release;
+  Vx<F> edges2 = bin_edges.cwiseProduct(bin_edges);
+  size_t n = std::max(x1.size(), x2.size());
+  Mx<int64_t> counts(n, nedge - 1);
+  counts.setZero();
+  parallel_for(
+      n,
+      [&](size_t i) {
+        size_t i1 = x1.size() == 1 ? 0 : i;
+        size_t i2 = x2.size() == 1 ? 0 : i;
+        X3<F> pos = x1[i1].inverse() * x2[i2];
+        BVHCountPairsHist<F> query(pos, edges2.data(), nedge,
+                                   counts.row(i).data());
+        hgeom::bvh::BVIntersect(bvh1, bvh2, query);
+      },
+      nthread);
+  return counts;
+}
+
+/*
+clash test, min distance and pair count from one traversal per pose.
+mindist is the clash threshold, maxdist the pair counting cutoff
+*/
+template <typename F>
+py::tuple bvh_multi_query_vec(BVH<F> &bvh1, BVH<F> &bvh2, py::array_t<F> pos1,
+                              py::array_t<F> pos2, F mindist, F maxdist,
+                              int nthread = 0) {
+  auto x1 = xform_py_to_eigen(pos1);
+  auto x2 = xform_py_to_eigen(pos2);
+  if (x1.size() != x2.size() && x1.size() != 1 && x2.size() != 1)
+    throw std::runtime_error("pos1 and pos2 must have same length");
+  size_t n = std::max(x1.size(), x2.size());
+  Vx<bool> isect(n);
+  Vx<F> mindis(n);
+  Vx<int> idx1(n), idx2(n), npair(n);
+  {
+    py::gil_scoped_release release;
+    parallel_for(
+        n,
+        [&](size_t i) {
+          size_t i1 = x1.size() == 1 ? 0 : i;
+          size_t i2 = x2.size() == 1 ? 0 : i;
+          X3<F> pos = x1[i1].inverse() * x2[i2];
+          BVHIsectQuery<F> qisect(mindist, pos);
+          BVHMinDistQuery<F> qmin(pos);
+          BVHCountPairs<F> qcount(maxdist, pos);
+          auto query = make_composite_intersector(qisect, qmin, qcount);
+          hgeom::bvh::BVIntersect(bvh1, bvh2, query);
+          isect[i] = qisect.result;
+          mindis[i] = qmin.minval;
+          idx1[i] = qmin.idx1;
+          idx2[i] = qmin.idx2;
+          npair[i] = qcount.nout;
+        },
+        nthread);
+  }
+  return py::make_tuple(std::move(isect), std::move(mindis), std::move(idx1),
+                        std::move(idx2), std::move(npair));
+}
+
+/*
+nearest neighbor in bvh2 for every object of bvh1, per pose, via the dual
+tree BVAllNearest. results are reported per object id of bvh1 (min over
+objects sharing an id), ids absent from bvh1 get 9e9 / -1. partner is the
+id of the nearest bvh2 object. also returns the directed hausdorff
+distance max_a min_b |a - b| per pose. with nthread > 1 the top of bvh1 is
+split into subtrees that are run concurrently
+*/
+template <typename F>
+void bvh_all_nearest_impl(BVH<F> &bvh1, BVH<F> &bvh2, X3<F> pos, F *dist,
+                          int *partner, F &hausdorff, int nthread = 1) {
+  size_t n1 = bvh1.objs.size();
+  std::vector<F> best(n1, std::numeric_limits<F>::max());
+  std::vector<F> bound(bvh1.vols.size());
+  std::vector<int> bestobj(n1, -1);
+  // disjoint subtrees of bvh1 touch disjoint best[] and bound[] entries
+  std::vector<int> roots(1, bvh1.getRootIndex());
+  while (nthread > 1 && roots.size() < 8 * (size_t)nthread) {
+    std::vector<int> next;
+    for (int r : roots) {
+      typename BVH<F>::VolumeIterator vbeg = nullptr, vend = nullptr;
+      typename BVH<F>::ObjectIterator obeg = nullptr, oend = nullptr;
+      bvh1.getChildren(r, vbeg, vend, obeg, oend);
+      if (vend - vbeg == 2)
+        next.insert(next.end(), vbeg, vend);
+      else
+        next.push_back(r);
+    }
+    if (next.size() == roots.size()) break;
+    roots.swap(next);
+  }
+  parallel_for(
+      roots.size(),
+      [&](size_t k) {
+        BVHMinDistQuery<F> minimizer(pos);
+        hgeom::bvh::BVAllNearest(bvh1, bvh2, minimizer, best.data(),
+                                 bestobj.data(), bound.data(), roots[k]);
+      },
+      nthread, 1);
+  hausdorff = 0;
+  for (size_t j = 0; j < n1; ++j) {
+    if (bestobj[j] < 0) best[j] = 9e9;
+    int id = bvh1.objs[j].idx;
+    if (best[j] < dist[id]) {
+      dist[id] = best[j];
+      partner[id] = bvh2.objs[bestobj[j]].idx;
+    }
+    hausdorff = std::max(hausdorff, best[j]);
+  }
+}
+template <typename F>
+py::tuple bvh_all_nearest_vec(BVH<F> &bvh1, BVH<F> &bvh2, py::array_t<F> pos1,
+                              py::array_t<F> pos2, int nthread = 0) {
+  auto x1 = xform_py_to_eigen(pos1);
+  auto x2 = xform_py_to_eigen(pos2);
+  if (x1.size() != x2.size() && x1.size() != 1 && x2.size() != 1)
+    throw std::runtime_error("pos1 and pos2 must have same length");
+  size_t n = std::max(x1.size(), x2.size());
+  int nid = bvh_max_id(bvh1) + 1;
+  Mx<F> dist(n, nid);
+  Mx<int> partner(n, nid);
+  Vx<F> hausdorff(n);
+  {
+    py::gil_scoped_release release;
+    dist.fill(9e9);
+    partner.fill(-1);
+    // threads go to the objects when there is only one pose
+    int nthread_obj = n == 1 ? nthread : 1;
+    parallel_for(
+        n,
+        [&](size_t i) {
+          size_t i1 = x1.size() == 1 ? 0 : i;
+          size_t i2 = x2.size() == 1 ? 0 : i;
+          X3<F> pos = x1[i1].inverse() * x2[i2];
+          bvh_all_nearest_impl(bvh1, bvh2, pos, dist.row(i).data(),
+                               partner.row(i).data(), hausdorff[i],
+                               nthread_obj);
+        },
+        n == 1 ? 1 : nthread);
+  }
+  return py::make_tuple(std::move(dist), std::move(partner),
+                        std::move(hausdorff));
+}
+template <typename F>
+Vx<F> bvh_hausdorff_vec(BVH<F> &bvh1, BVH<F> &bvh2, py::array_t<F> pos1,
+                        py::array_t<F> pos2, int nthread = 0) {
+  auto x1 = xform_py_to_eigen(pos1);
+  auto x2 = xform_py_to_eigen(pos2);
+  if (x1.size() != x2.size() && x1.size() != 1 && x2.size() != 1)
+    throw std::runtime_error("pos1 and pos2 must have same length");
+  size_t n = std::max(x1.size(), x2.size());
+  Vx<F> hausdorff(n);
+  {
+    py::gil_scoped_release release;
+    int nid1 = bvh_max_id(bvh1) + 1, nid2 = bvh_max_id(bvh2) + 1;
+    int nthread_obj = n == 1 ? nthread : 1;
+    parallel_for(
+        n,
+        [&](size_t i) {
+          size_t i1 = x1.size() == 1 ? 0 : i;
+          size_t i2 = x2.size() == 1 ? 0 : i;
+          X3<F> pos = x1[i1].inverse() * x2[i2];
+          Vx<F> d1 = Vx<F>::Constant(nid1, 9e9), d2 = Vx<F>::Constant(nid2, 9e9);
+          Vx<int> p1(nid1), p2(nid2);
+          F h1, h2;
+          bvh_all_nearest_impl(bvh1, bvh2, pos, d1.data(), p1.data(), h1,
+                               nthread_obj);
+          bvh_all_nearest_impl(bvh2, bvh1, X3<F>(pos.inverse()), d2.data(),
+                               p2.data(), h2, nthread_obj);
+          hausdorff[i] = std::max(h1, h2);
+        },
+        n == 1 ? 1 : nthread);
+  }
+  return hausdorff;
+}
+
+/*
+symmetric assemblies. the asu sits at pos[i] and copy k at syms[k] * pos[i],
+so copy k relative to the asu is pos^-1 * syms[k] * pos. identity operators
+are skipped. an operator whose root sphere cannot come within the cutoff of
+the asu root sphere is pruned before any traversal. work is spread over
+poses x operators; isect stops checking a pose once any copy clashes
+*/
+template <typename F>
+std::vector<X3<F>> bvh_sym_ops(py::array_t<F> syms) {
+  auto xs = xform_py_to_eigen(syms);
+  std::vector<X3<F>> ops;
+  for (int k = 0; k < xs.size(); ++k)
+    if (!xs[k].matrix().isIdentity(epsilon2<F>())) ops.push_back(xs[k]);
+  return ops;
+}
+template <typename F>
+bool bvh_sym_pruned(BVH<F> &bvh, X3<F> const &x, F cutoff) {
+  if (bvh.getRootIndex() < 0) return false;
+  auto const &root = bvh.getVolume(bvh.getRootIndex());
+  return (root.cen - x * root.cen).norm() - 2 * root.rad >= cutoff;
+}
+template <typename F>
+Vx<bool> bvh_isect_sym_vec(BVH<F> &bvh, py::array_t<F> pos,
+                           py::array_t<F> syms, F mindist, int nthread = 0) {
+  auto x = xform_py_to_eigen(pos);
+  auto ops = bvh_sym_ops(syms);
+  size_t n = x.size(), nsym = ops.size();
+  Vx<bool> isect = Vx<bool>::Constant(n, false);
+  {
+    py::gil_scoped_release release;
+    std::unique_ptr<std::atomic<bool>[]> hit(new std::atomic<bool>[n]);
+    for (size_t i = 0; i < n; ++i) hit[i] = false;
+    parallel_for(
+        n * nsym,
+        [&](size_t j) {
+          size_t i = j / nsym, k = j % nsym;
+          if (hit[i].load(std::memory_order_relaxed)) return;
+          X3<F> rel = x[i].inverse() * ops[k] * x[i];
+          if (bvh_sym_pruned(bvh, rel, mindist)) return;
+          BVHIsectQuery<F> query(mindist, rel);
+          hgeom::bvh::BVIntersect(bvh, bvh, query);
+          if (query.result) hit[i] = true;
+        },
+        nthread);
+    for (size_t i = 0; i < n; ++i) isect[i] = hit[i];
+  }
+  return isect;
+}
+template <typename F>
+Mx<int> bvh_count_pairs_sym_vec(BVH<F> &bvh, py::array_t<F> pos,
+                                py::array_t<F> syms, F maxdist,
+                                int nthread = 0) {
+  auto x = xform_py_to_eigen(pos);
+  auto xs = xform_py_to_eigen(syms);
+  size_t n = x.size(), nsym = xs.size();
+  Mx<int> npair = Mx<int>::Zero(n, nsym);
+  {
+    py::gil_scoped_release release;
+    parallel_for(
+        n * nsym,
+        [&](size_t j) {
+          size_t i = j / nsym, k = j % nsym;
+          if (xs[k].matrix().isIdentity(epsilon2<F>())) return;
+          X3<F> rel = x[i].inverse() * xs[k] * x[i];
+          if (bvh_sym_pruned(bvh, rel, maxdist)) return;
+          BVHCountPairs<F> query(maxdist, rel);
+          hgeom::bvh::BVIntersect(bvh, bvh, query);
+          npair(i, k) = query.nout;
+        },
+        nthread);
+  }
+  return npair;
+}
+
+template <typename F> struct BVHCollectPairs {
+  using Scalar = F;
+  using Xform = X3<F>;
+  F mindis = 0.0, mindis2 = 0.0;
+  Xform bXa = Xform::Identity();
+  int32_t *out;
+  int nout = 0, maxout = -1;
+  bool overflow = false;
+  BVHCollectPairs(F r, Xform x, int32_t *ptr, int mx)
+      : mindis(r), bXa(x), out(ptr), maxout(mx), mindis2(r * r) {}
+  bool intersectVolumeVolume(Sphere<F> vol1, Sphere<F> vol2) {
+    return vol1.signdis(bXa * vol2) < mindis;
+  }
+  bool intersectVolumeObject(Sphere<F> vol1, PtIdx<F> obj2) {
+    return vol1.signdis(bXa * obj2.pos) < mindis;
   }
   bool intersectObjectVolume(PtIdx<F> obj1, Sphere<F> vol2) {
     return (bXa * vol2).signdis(obj1.pos) < mindis;
@@ -895,24 +2148,40 @@ template <typename F> struct BVHCollectPairsVec {
     }
     return false;
   }
+  template <typename O>
+  bool intersectVolumeObject(Sphere<F> vol1, O const &obj2) {
+    return obj_dist(vol1.cen, vol1.rad, bXa * obj2) < maxdis;
+  }
+  template <typename O>
+  bool intersectObjectVolume(O const &obj1, Sphere<F> vol2) {
+    auto v = bXa * vol2;
+    return obj_dist(v.cen, v.rad, obj1) < maxdis;
+  }
+  template <typename O1, typename O2>
+  bool intersectObjectObject(O1 const &obj1, O2 const &obj2) {
+    if (obj_dist(obj1, bXa * obj2) < maxdis) {
+      out.push_back(obj1.idx);
+      out.push_back(obj2.idx);
+    }
+    return false;
+  }
 };
 
-template <typename F, typename XF>
-py::tuple bvh_collect_pairs_vec(BVH<F> &bvh1, BVH<F> &bvh2,
-                                py::array_t<XF> pos1, py::array_t<XF> pos2,
-                                F maxdist) {
+template <typename F, typename XF, typename BVH1 = BVH<F>,
+          typename BVH2 = BVH<F>>
+py::tuple bvh_collect_pairs_vec(BVH1 &bvh1, BVH2 &bvh2, py::array_t<XF> pos1,
+                                py::array_t<XF> pos2, F maxdist) {
   auto x1 = xform_py_to_eigen(pos1);
   auto x2 = xform_py_to_eigen(pos2);
   if (x1.size() != x2.size() && x1.size() != 1 && x2.size() != 1)
     throw std::runtime_error("pos1 and pos2 must have same len");
 
   auto lbub = std::make_unique<Matrix<int, Dynamic, 2, RowMajor>>();
-  auto out = std::make_unique<Mx<int32_t>>();
+  std::vector<int32_t> pairs;
   {
     py::gil_scoped_release release;
     size_t n = std::max(x1.size(), x2.size());
     lbub->resize(n, 2);
-    std::vector<int32_t> pairs;
     pairs.reserve(10 * n);
     for (size_t i = 0; i < n; ++i) {
       size_t i1 = x1.size() == 1 ? 0 : i;
@@ -923,13 +2192,155 @@ py::tuple bvh_collect_pairs_vec(BVH<F> &bvh1, BVH<F> &bvh2,
       hgeom::bvh::BVIntersect(bvh1, bvh2, query);
       (*lbub)(i, 1) = pairs.size() / 2;
     }
-    out->resize(pairs.size() / 2, 2);
-    for (size_t i = 0; i < pairs.size() / 2; ++i) {
-      (*out)(i, 0) = pairs[2 * i + 0];
-      (*out)(i, 1) = pairs[2 * i + 1];
+  }
+  py::ssize_t npair = pairs.size() / 2;
+  return py::make_tuple(vector_to_py(std::move(pairs), {npair, 2}),
+                        std::move(*lbub));
+}
+
+/*
+streaming collect pairs, for scans whose pair list would not fit in memory.
+poses are processed in order and pairs handed out in chunks of whole poses,
+each holding at least `chunk` pairs (except the last), so peak memory is
+about one chunk plus the pairs of one pose. a chunk is (pairs, lbub, start)
+where lbub rows index into this chunk's pairs and start is the index of the
+chunk's first pose. usable as a python iterator, via a callback, or written
+straight to an .npy file
+*/
+template <typename F> struct BVHCollectPairsStream {
+  BVH<F> &bvh1, &bvh2;
+  py::array_t<F> pos1, pos2; // keeps the pose buffers alive
+  MapVxX3<F> x1, x2;
+  F maxdist;
+  size_t chunk, n = 0, next = 0, start = 0;
+  std::vector<int32_t> pairs;
+  std::vector<int> lbub;
+  BVHCollectPairsStream(BVH<F> &b1, BVH<F> &b2, py::array_t<F> p1,
+                        py::array_t<F> p2, F d, int64_t c)
+      : bvh1(b1), bvh2(b2), pos1(p1), pos2(p2), x1(xform_py_to_eigen(pos1)),
+        x2(xform_py_to_eigen(pos2)), maxdist(d), chunk(c) {
+    if (x1.size() != x2.size() && x1.size() != 1 && x2.size() != 1)
+      throw std::runtime_error("pos1 and pos2 must have same len");
+    if (c <= 0) throw std::runtime_error("chunk must be > 0");
+    n = std::max(x1.size(), x2.size());
+  }
+  // collects the next poses into pairs/lbub, false when all are done
+  bool fill() {
+    pairs.clear();
+    lbub.clear();
+    if (next >= n) return false;
+    start = next;
+    while (next < n && pairs.size() / 2 < chunk) {
+      size_t i1 = x1.size() == 1 ? 0 : next;
+      size_t i2 = x2.size() == 1 ? 0 : next;
+      BVHCollectPairsVec<F> query(maxdist, x1[i1].inverse() * x2[i2], pairs);
+      lbub.push_back(pairs.size() / 2);
+      hgeom::bvh::BVIntersect(bvh1, bvh2, query);
+      lbub.push_back(pairs.size() / 2);
+      ++next;
+    }
+    return true;
+  }
+  // hands the buffers to numpy without copying; the next fill() starts over
+  // with fresh ones
+  py::tuple chunk_py() {
+    py::ssize_t npair = pairs.size() / 2, nquery = lbub.size() / 2;
+    return py::make_tuple(vector_to_py(std::move(pairs), {npair, 2}),
+                          vector_to_py(std::move(lbub), {nquery, 2}),
+                          (int64_t)start);
+  }
+  py::tuple next_py() {
+    bool more;
+    {
+      py::gil_scoped_release release;
+      more = fill();
+    }
+    if (!more) throw py::stop_iteration();
+    return chunk_py();
+  }
+};
+template <typename F>
+std::unique_ptr<BVHCollectPairsStream<F>>
+bvh_collect_pairs_iter(BVH<F> &bvh1, BVH<F> &bvh2, py::array_t<F> pos1,
+                       py::array_t<F> pos2, F maxdist, int64_t chunk) {
+  return std::make_unique<BVHCollectPairsStream<F>>(bvh1, bvh2, pos1, pos2,
+                                                    maxdist, chunk);
+}
+template <typename F>
+int64_t bvh_collect_pairs_chunked(BVH<F> &bvh1, BVH<F> &bvh2,
+                                  py::array_t<F> pos1, py::array_t<F> pos2,
+                                  F maxdist, py::function callback,
+                                  int64_t chunk) {
+  BVHCollectPairsStream<F> stream(bvh1, bvh2, pos1, pos2, maxdist, chunk);
+  int64_t total = 0;
+  while (true) {
+    bool more;
+    {
+      py::gil_scoped_release release;
+      more = stream.fill();
     }
+    if (!more) break;
+    total += stream.pairs.size() / 2;
+    auto c = stream.chunk_py();
+    callback(c[0], c[1], c[2]);
   }
-  return py::make_tuple(*out, *lbub);
+  return total;
+}
+
+// fixed size .npy v1.0 header for an (nrow, 2) int32 array, so it can be
+// rewritten in place once nrow is known
+inline void write_npy_header_pairs(std::FILE *f, int64_t nrow) {
+  size_t const hlen = 128 - 10;
+  std::string dict = "{'descr': '<i4', 'fortran_order': False, 'shape': (" +
+                     std::to_string(nrow) + ", 2), }";
+  dict.resize(hlen - 1, ' ');
+  dict += '\n';
+  char const magic[10] = {'\x93', 'N', 'U', 'M', 'P', 'Y', 1, 0,
+                          (char)(hlen & 0xff), (char)(hlen >> 8)};
+  std::fseek(f, 0, SEEK_SET);
+  std::fwrite(magic, 1, 10, f);
+  std::fwrite(dict.data(), 1, hlen, f);
+}
+/*
+streams pairs into an (npair, 2) int32 .npy file, open it afterwards with
+np.load(fname, mmap_mode='r'). returns lbub (N,2) into the file's rows
+*/
+template <typename F>
+Matrix<int64_t, Dynamic, 2, RowMajor>
+bvh_collect_pairs_npy(BVH<F> &bvh1, BVH<F> &bvh2, py::array_t<F> pos1,
+                      py::array_t<F> pos2, F maxdist, std::string fname,
+                      int64_t chunk) {
+  BVHCollectPairsStream<F> stream(bvh1, bvh2, pos1, pos2, maxdist, chunk);
+  Matrix<int64_t, Dynamic, 2, RowMajor> lbub(stream.n, 2);
+  {
+    py::gil_scoped_release release;
+    std::unique_ptr<std::FILE, int (*)(std::FILE *)> f(
+        std::fopen(fname.c_str(), "wb"), &std::fclose);
+    if (!f) throw std::runtime_error("can't open file " + fname);
+    write_npy_header_pairs(f.get(), 0);
+    int64_t total = 0;
+    while (stream.fill()) {
+      for (size_t k = 0; k < stream.lbub.size() / 2; ++k) {
+        lbub(stream.start + k, 0) = total + stream.lbub[2 * k + 0];
+        lbub(stream.start + k, 1) = total + stream.lbub[2 * k + 1];
+      }
+      size_t nwrite = stream.pairs.size();
+      if (std::fwrite(stream.pairs.data(), sizeof(int32_t), nwrite, f.get()) !=
+          nwrite)
+        throw std::runtime_error("write failed " + fname);
+      total += nwrite / 2;
+    }
+    write_npy_header_pairs(f.get(), total);
+  }
+  return lbub;
+}
+template <typename F>
+void bind_collect_pairs_stream(py::module_ m, std::string name) {
+  using Stream = BVHCollectPairsStream<F>;
+  py::class_<Stream>(m, name.c_str())
+      .def("__iter__", [](Stream &s) -> Stream & { return s; },
+           py::return_value_policy::reference_internal)
+      .def("__next__", &Stream::next_py);
 }
 
 template <typename F> struct BVHCollectPairsRangeVec {
@@ -997,7 +2408,7 @@ py::tuple bvh_collect_pairs_range_vec(BVH<F> &bvh1, BVH<F> &bvh2,
     throw std::runtime_error("lb2/ub2 must be broadcastable");
 
   auto lbub = std::make_unique<Matrix<int, Dynamic, 2, RowMajor>>();
-  auto out = std::make_unique<Mx<int32_t>>();
+  std::vector<int32_t> pairs;
   {
     py::gil_scoped_release release;
     size_t n = std::max(std::max(std::max(x1.size(), x2.size()),
@@ -1016,7 +2427,6 @@ py::tuple bvh_collect_pairs_range_vec(BVH<F> &bvh1, BVH<F> &bvh2,
     // << (float)bvh2.size() / nasym2 << std::endl;
     n = n0 ? n : 0;
     lbub->resize(n, 2);
-    std::vector<int32_t> pairs;
     pairs.reserve(10 * n);
     for (size_t i = 0; i < n; ++i) {
       size_t ix1 = x1.size() == 1 ? 0 : i;
@@ -1037,13 +2447,608 @@ py::tuple bvh_collect_pairs_range_vec(BVH<F> &bvh1, BVH<F> &bvh2,
       hgeom::bvh::BVIntersect(bvh1, bvh2, query);
       (*lbub)(i, 1) = pairs.size() / 2;
     }
-    out->resize(pairs.size() / 2, 2);
-    for (size_t i = 0; i < pairs.size() / 2; ++i) {
-      (*out)(i, 0) = pairs[2 * i + 0];
-      (*out)(i, 1) = pairs[2 * i + 1];
+  }
+  py::ssize_t npair = pairs.size() / 2;
+  return py::make_tuple(vector_to_py(std::move(pairs), {npair, 2}),
+                        std::move(*lbub));
+}
+
+/*
+arbitrary id subsets. IdMask is a bitset over object ids with a fast "any
+selected in [lb, ub]" test. every vol of a BVH carries idblocks, a 64 bit
+block map over its own id span [lb, ub] (see bvh_refit_id_bounds), set up
+once with the tree. a vol (and its whole subtree) is skipped if no selected
+id falls in any of its occupied blocks. it is exact for vols spanning fewer
+than 64 ids
+*/
+struct IdMask {
+  std::vector<uint64_t> words;
+  int nbits = 0;
+  IdMask(bool const *sel, int n) : words((n + 63) / 64, 0), nbits(n) {
+    for (int i = 0; i < n; ++i)
+      if (sel[i]) words[i >> 6] |= uint64_t(1) << (i & 63);
+  }
+  bool test(int i) const {
+    return i >= 0 && i < nbits && (words[i >> 6] >> (i & 63)) & 1;
+  }
+  bool any(int lb, int ub) const {
+    lb = std::max(lb, 0);
+    ub = std::min(ub, nbits - 1);
+    if (lb > ub) return false;
+    int wl = lb >> 6, wu = ub >> 6;
+    uint64_t lo = ~uint64_t(0) << (lb & 63);
+    uint64_t hi = ~uint64_t(0) >> (63 - (ub & 63));
+    if (wl == wu) return words[wl] & lo & hi;
+    if (words[wl] & lo) return true;
+    for (int w = wl + 1; w < wu; ++w)
+      if (words[w]) return true;
+    return words[wu] & hi;
+  }
+  template <typename F> bool any(Sphere<F> const &vol) const {
+    if (!any(vol.lb, vol.ub)) return false;
+    int s = id_block_shift(vol.lb, vol.ub);
+    for (uint64_t b = vol.idblocks; b; b &= b - 1) {
+      int64_t blb = vol.lb + ((int64_t)__builtin_ctzll(b) << s);
+      if (blb > vol.ub) break;
+      int64_t bub = std::min<int64_t>(vol.ub, blb + (int64_t(1) << s) - 1);
+      if (any((int)blb, (int)bub)) return true;
+    }
+    return false;
+  }
+};
+
+inline std::vector<IdMask> id_masks_py(Mx<bool> const &mask,
+                                       char const *name) {
+  if (mask.rows() == 0 || mask.cols() == 0)
+    throw std::runtime_error(std::string(name) + " must be shape (N, nid)");
+  std::vector<IdMask> out;
+  for (int i = 0; i < mask.rows(); ++i)
+    out.emplace_back(mask.row(i).data(), mask.cols());
+  return out;
+}
+
+struct BVHIdMaskFilter {
+  IdMask const &mask1, &mask2;
+  template <typename F> bool vol1(Sphere<F> const &v) const {
+    return mask1.any(v);
+  }
+  template <typename F> bool vol2(Sphere<F> const &v) const {
+    return mask2.any(v);
+  }
+  template <typename F> bool obj1(PtIdx<F> const &o) const {
+    return mask1.test(o.idx);
+  }
+  template <typename F> bool obj2(PtIdx<F> const &o) const {
+    return mask2.test(o.idx);
+  }
+};
+
+template <typename F> struct BVHIsectMask {
+  using Scalar = F;
+  using Xform = X3<F>;
+  F rad = 0, rad2 = 0;
+  Xform bXa = Xform::Identity();
+  BVHIdMaskFilter sel;
+  bool result = false;
+  int clashidA = -1, clashidB = -1;
+  BVHIsectMask(F r, Xform x, BVHIdMaskFilter s)
+      : rad(r), rad2(r * r), bXa(x), sel(s) {}
+  bool intersectVolumeVolume(Sphere<F> const &vol1, Sphere<F> const &vol2) {
+    if (!sel.vol1(vol1) || !sel.vol2(vol2)) return false;
+    return vol1.signdis(bXa * vol2) < rad;
+  }
+  bool intersectVolumeObject(Sphere<F> const &vol1, PtIdx<F> obj2) {
+    if (!sel.vol1(vol1) || !sel.obj2(obj2)) return false;
+    return vol1.signdis(bXa * obj2.pos) < rad;
+  }
+  bool intersectObjectVolume(PtIdx<F> obj1, Sphere<F> const &vol2) {
+    if (!sel.obj1(obj1) || !sel.vol2(vol2)) return false;
+    return (bXa * vol2).signdis(obj1.pos) < rad;
+  }
+  bool intersectObjectObject(PtIdx<F> obj1, PtIdx<F> obj2) {
+    if (!sel.obj1(obj1) || !sel.obj2(obj2)) return false;
+    if ((obj1.pos - bXa * obj2.pos).squaredNorm() >= rad2) return false;
+    clashidA = obj1.idx;
+    clashidB = obj2.idx;
+    return result = true;
+  }
+};
+
+template <typename F> struct BVHCollectPairsMask {
+  using Scalar = F;
+  using Xform = X3<F>;
+  F d = 0, d2 = 0;
+  Xform bXa = Xform::Identity();
+  BVHIdMaskFilter sel;
+  std::vector<int32_t> &out;
+  BVHCollectPairsMask(F r, Xform x, BVHIdMaskFilter s,
+                      std::vector<int32_t> &o)
+      : d(r), d2(r * r), bXa(x), sel(s), out(o) {}
+  bool intersectVolumeVolume(Sphere<F> const &vol1, Sphere<F> const &vol2) {
+    if (!sel.vol1(vol1) || !sel.vol2(vol2)) return false;
+    return vol1.signdis(bXa * vol2) < d;
+  }
+  bool intersectVolumeObject(Sphere<F> const &vol1, PtIdx<F> obj2) {
+    if (!sel.vol1(vol1) || !sel.obj2(obj2)) return false;
+    return vol1.signdis(bXa * obj2.pos) < d;
+  }
+  bool intersectObjectVolume(PtIdx<F> obj1, Sphere<F> const &vol2) {
+    if (!sel.obj1(obj1) || !sel.vol2(vol2)) return false;
+    return (bXa * vol2).signdis(obj1.pos) < d;
+  }
+  bool intersectObjectObject(PtIdx<F> obj1, PtIdx<F> obj2) {
+    if (!sel.obj1(obj1) || !sel.obj2(obj2)) return false;
+    if ((obj1.pos - bXa * obj2.pos).squaredNorm() < d2) {
+      out.push_back(obj1.idx);
+      out.push_back(obj2.idx);
+    }
+    return false;
+  }
+};
+
+template <typename F>
+py::tuple bvh_isect_mask_vec(BVH<F> &bvh1, BVH<F> &bvh2, py::array_t<F> pos1,
+                             py::array_t<F> pos2, F mindist,
+                             Mx<bool> const &mask1, Mx<bool> const &mask2,
+                             int nthread = 0) {
+  auto x1 = xform_py_to_eigen(pos1);
+  auto x2 = xform_py_to_eigen(pos2);
+  auto m1 = id_masks_py(mask1, "mask1");
+  auto m2 = id_masks_py(mask2, "mask2");
+  size_t nx1 = x1.size(), nx2 = x2.size(), nm1 = m1.size(), nm2 = m2.size();
+  size_t n = std::max({nx1, nx2, nm1, nm2});
+  for (size_t len : {nx1, nx2, nm1, nm2})
+    if (len != 1 && len != n)
+      throw std::runtime_error("pos1/pos2/mask1/mask2 must be broadcastable");
+  Vx<bool> out(n);
+  Mx<int> clashid(n, 2);
+  {
+    py::gil_scoped_release release;
+    parallel_for(
+        n,
+        [&](size_t i) {
+          size_t i1 = x1.size() == 1 ? 0 : i;
+          size_t i2 = x2.size() == 1 ? 0 : i;
+          BVHIdMaskFilter sel{m1[m1.size() == 1 ? 0 : i],
+                              m2[m2.size() == 1 ? 0 : i]};
+          BVHIsectMask<F> query(mindist, x1[i1].inverse() * x2[i2], sel);
+          hgeom::bvh::BVIntersect(bvh1, bvh2, query);
+          out[i] = query.result;
+          clashid(i, 0) = query.clashidA;
+          clashid(i, 1) = query.clashidB;
+        },
+        nthread);
+  }
+  return py::make_tuple(std::move(out), std::move(clashid));
+}
+
+template <typename F>
+py::tuple bvh_collect_pairs_mask_vec(BVH<F> &bvh1, BVH<F> &bvh2,
+                                     py::array_t<F> pos1, py::array_t<F> pos2,
+                                     F maxdist, Mx<bool> const &mask1,
+                                     Mx<bool> const &mask2) {
+  auto x1 = xform_py_to_eigen(pos1);
+  auto x2 = xform_py_to_eigen(pos2);
+  auto m1 = id_masks_py(mask1, "mask1");
+  auto m2 = id_masks_py(mask2, "mask2");
+  size_t nx1 = x1.size(), nx2 = x2.size(), nm1 = m1.size(), nm2 = m2.size();
+  size_t n = std::max({nx1, nx2, nm1, nm2});
+  for (size_t len : {nx1, nx2, nm1, nm2})
+    if (len != 1 && len != n)
+      throw std::runtime_error("pos1/pos2/mask1/mask2 must be broadcastable");
+  auto lbub = std::make_unique<Matrix<int, Dynamic, 2, RowMajor>>();
+  std::vector<int32_t> pairs;
+  {
+    py::gil_scoped_release release;
+    lbub->resize(n, 2);
+    pairs.reserve(10 * n);
+    for (size_t i = 0; i < n; ++i) {
+      size_t i1 = x1.size() == 1 ? 0 : i;
+      size_t i2 = x2.size() == 1 ? 0 : i;
+      BVHIdMaskFilter sel{m1[m1.size() == 1 ? 0 : i],
+                          m2[m2.size() == 1 ? 0 : i]};
+      BVHCollectPairsMask<F> query(maxdist, x1[i1].inverse() * x2[i2], sel,
+                                   pairs);
+      (*lbub)(i, 0) = pairs.size() / 2;
+      hgeom::bvh::BVIntersect(bvh1, bvh2, query);
+      (*lbub)(i, 1) = pairs.size() / 2;
+    }
+  }
+  py::ssize_t npair = pairs.size() / 2;
+  return py::make_tuple(vector_to_py(std::move(pairs), {npair, 2}),
+                        std::move(*lbub));
+}
+
+/*
+pairwise energy summed inside the traversal, no pair list is materialized.
+table is (ntype, ntype, nbins), bins evenly span [0, maxdist). types1/types2
+are indexed by object id. if res1/res2 are non-null, each pair energy is also
+accumulated onto both participating object ids.
+*/
+template <typename F> struct BVHScorePairsBinned {
+  using Scalar = F;
+  using Xform = X3<F>;
+  F maxdis = 0.0, maxdis2 = 0.0, binscale = 0.0;
+  Xform bXa = Xform::Identity();
+  int const *types1, *types2;
+  F const *table;
+  int ntype, nbins;
+  F *res1 = nullptr, *res2 = nullptr;
+  F score = 0;
+  BVHScorePairsBinned(F r, Xform x, int const *t1, int const *t2,
+                      F const *tab, int nt, int nb)
+      : maxdis(r), maxdis2(r * r), binscale(nb / r), bXa(x), types1(t1),
+        types2(t2), table(tab), ntype(nt), nbins(nb) {}
+  bool intersectVolumeVolume(Sphere<F> vol1, Sphere<F> vol2) {
+    return vol1.signdis(bXa * vol2) < maxdis;
+  }
+  bool intersectVolumeObject(Sphere<F> vol1, PtIdx<F> obj2) {
+    return vol1.signdis(bXa * obj2.pos) < maxdis;
+  }
+  bool intersectObjectVolume(PtIdx<F> obj1, Sphere<F> vol2) {
+    return (bXa * vol2).signdis(obj1.pos) < maxdis;
+  }
+  bool intersectObjectObject(PtIdx<F> obj1, PtIdx<F> obj2) {
+    F d2 = (obj1.pos - bXa * obj2.pos).squaredNorm();
+    if (d2 < maxdis2) {
+      int ibin = std::min((int)(std::sqrt(d2) * binscale), nbins - 1);
+      int t1 = types1[obj1.idx], t2 = types2[obj2.idx];
+      F e = table[(t1 * ntype + t2) * nbins + ibin];
+      score += e;
+      if (res1) res1[obj1.idx] += e;
+      if (res2) res2[obj2.idx] += e;
+    }
+    return false;
+  }
+};
+
+template <typename F>
+py::object bvh_score_pairs_binned(BVH<F> &bvh1, BVH<F> &bvh2,
+                                 py::array_t<F> pos1, py::array_t<F> pos2,
+                                 F maxdist, Vx<int> types1, Vx<int> types2,
+                                 py::array_t<F> table, bool per_res = false,
+                                 int nthread = 0) {
+  auto x1 = xform_py_to_eigen(pos1);
+  auto x2 = xform_py_to_eigen(pos2);
+  if (x1.size() != x2.size() && x1.size() != 1 && x2.size() != 1)
+    throw std::runtime_error("pos1 and pos2 must have same len");
+  if (table.ndim() != 3 || table.shape()[0] != table.shape()[1] ||
+      table.shape()[0] < 1 || table.shape()[2] < 1)
+    throw std::runtime_error(
+        "table must be shape (ntype, ntype, nbins) with nbins >= 1");
+  if (maxdist <= 0) throw std::runtime_error("maxdist must be > 0");
+  int nres1 = bvh_max_id(bvh1) + 1, nres2 = bvh_max_id(bvh2) + 1;
+  if (types1.size() < nres1 || types2.size() < nres2)
+    throw std::runtime_error("types must cover all object ids in bvh");
+  int ntype = table.shape()[0], nbins = table.shape()[2];
+  if (types1.minCoeff() < 0 || types1.maxCoeff() >= ntype ||
+      types2.minCoeff() < 0 || types2.maxCoeff() >= ntype)
+    throw std::runtime_error("types must be in [0, ntype)");
+  auto tab = py::array_t<F, py::array::c_style>::ensure(table);
+  F const *ptab = tab.data();
+
+  size_t n = std::max(x1.size(), x2.size());
+  Vx<F> score(n);
+  Mx<F> res1(per_res ? n : 0, nres1), res2(per_res ? n : 0, nres2);
+  {
+    py::gil_scoped_release release;
+    res1.setZero();
+    res2.setZero();
+    parallel_for(
+        n,
+        [&](size_t i) {
+          size_t i1 = x1.size() == 1 ? 0 : i;
+          size_t i2 = x2.size() == 1 ? 0 : i;
+          X3<F> pos = x1[i1].inverse() * x2[i2];
+          BVHScorePairsBinned<F> query(maxdist, pos, types1.data(),
+                                       types2.data(), ptab, ntype, nbins);
+          if (per_res) {
+            query.res1 = res1.row(i).data();
+            query.res2 = res2.row(i).data();
+          }
+          hgeom::bvh::BVIntersect(bvh1, bvh2, query);
+          score[i] = query.score;
+        },
+        nthread);
+  }
+  if (per_res)
+    return py::make_tuple(std::move(score), std::move(res1), std::move(res2));
+  return py::cast(score);
+}
+
+template <typename F>
+F naive_score_pairs_binned(BVH<F> &bvh1, BVH<F> &bvh2, M4<F> pos1, M4<F> pos2,
+                           F maxdist, Vx<int> types1, Vx<int> types2,
+                           py::array_t<F> table) {
+  auto tab = py::array_t<F, py::array::c_style>::ensure(table);
+  if (tab.ndim() != 3 || tab.shape()[0] != tab.shape()[1] ||
+      tab.shape()[0] < 1 || tab.shape()[2] < 1)
+    throw std::runtime_error(
+        "table must be shape (ntype, ntype, nbins) with nbins >= 1");
+  int ntype = tab.shape()[0], nbins = tab.shape()[2];
+  X3<F> x1(pos1), x2(pos2);
+  X3<F> pos = x1.inverse() * x2;
+  F score = 0;
+  for (auto o1 : bvh1.objs) {
+    for (auto o2 : bvh2.objs) {
+      F d = (o1.pos - pos * o2.pos).norm();
+      if (d >= maxdist) continue;
+      int ibin = std::min((int)(d * nbins / maxdist), nbins - 1);
+      int t1 = types1[o1.idx], t2 = types2[o2.idx];
+      score += tab.data()[(t1 * ntype + t2) * nbins + ibin];
     }
   }
-  return py::make_tuple(*out, *lbub);
+  return score;
+}
+
+template <typename F>
+using DockXbin = hgeom::xbin::XformHash_bt24_BCC6<X3<F>, uint64_t>;
+template <typename V> using DockMap = hgeom::phmap::PHMap<uint64_t, V>;
+
+/*
+counts pairs within maxdis and, if map is set, sums map[xbin key of the
+pair's stub to stub xform] over them. stubs are indexed by object id
+*/
+template <typename F, typename V> struct BVHDockScore {
+  using Scalar = F;
+  using Xform = X3<F>;
+  F maxdis = 0.0, maxdis2 = 0.0;
+  Xform bXa = Xform::Identity();
+  DockXbin<F> const *xbin = nullptr;
+  DockMap<V> const *map = nullptr;
+  X3<F> const *stubinv1 = nullptr, *stub2 = nullptr;
+  int ncontact = 0;
+  double score = 0;
+  BVHDockScore(F r, Xform x) : maxdis(r), maxdis2(r * r), bXa(x) {}
+  bool intersectVolumeVolume(Sphere<F> vol1, Sphere<F> vol2) {
+    return vol1.signdis(bXa * vol2) < maxdis;
+  }
+  bool intersectVolumeObject(Sphere<F> vol1, PtIdx<F> obj2) {
+    return vol1.signdis(bXa * obj2.pos) < maxdis;
+  }
+  bool intersectObjectVolume(PtIdx<F> obj1, Sphere<F> vol2) {
+    return (bXa * vol2).signdis(obj1.pos) < maxdis;
+  }
+  bool intersectObjectObject(PtIdx<F> obj1, PtIdx<F> obj2) {
+    if ((obj1.pos - bXa * obj2.pos).squaredNorm() >= maxdis2) return false;
+    ++ncontact;
+    if (map)
+      score += map->get_default(
+          xbin->get_key(stubinv1[obj1.idx] * (bXa * stub2[obj2.idx])));
+    return false;
+  }
+};
+
+struct DockHit {
+  double score;
+  int ncontact, iori, idir;
+  double slide;
+  // better score first, ties by scan order so results don't depend on threads
+  bool operator<(DockHit const &o) const {
+    if (score != o.score) return score > o.score;
+    return std::tie(iori, idir) < std::tie(o.iori, o.idir);
+  }
+};
+using DockHeap = std::priority_queue<DockHit>; // top() is the worst kept
+
+inline void dock_keep(DockHeap &heap, DockHit const &h, int topk) {
+  if ((int)heap.size() < topk)
+    heap.push(h);
+  else if (h < heap.top()) {
+    heap.pop();
+    heap.push(h);
+  }
+}
+
+/*
+docking scan with body1 fixed in the global frame. each start pose of body2
+in oris is slid along each of the (D,3) dirns until its objects come within
+2*rad of body1's, then pairs within contact_dist are counted. with xbin and
+phmap the score is the sum of phmap values of the pairs' stub xbin keys,
+stubs1/stubs2 being (N,4,4) frames indexed by object id, else the contact
+count. poses are scanned in parallel chunks, each keeping its own top k
+merged under a lock, so memory stays at about k per thread however many poses
+are scanned. returns the top k (score, ncontact, pose, iori, idir), best
+first. poses where the slide misses are dropped
+*/
+template <typename F, typename V>
+py::tuple bvh_dock(BVH<F> &bvh1, BVH<F> &bvh2, py::array_t<F> oris,
+                   Mx<F> dirns, F rad, F contact_dist, int topk,
+                   DockXbin<F> const *xbin, DockMap<V> const *phmap,
+                   py::array_t<F> stubs1, py::array_t<F> stubs2, int nthread) {
+  auto ori = xform_py_to_eigen(oris);
+  if (dirns.cols() != 3) throw std::runtime_error("dirns must be shape (D,3)");
+  for (int k = 0; k < dirns.rows(); ++k)
+    if (dirns.row(k).norm() < 0.0001)
+      throw std::runtime_error("Slide direction must not be 0");
+  if (rad <= 0) throw std::runtime_error("rad must be > 0");
+  if (topk <= 0) throw std::runtime_error("topk must be > 0");
+  if (!xbin != !phmap)
+    throw std::runtime_error("xbin and phmap must be given together");
+  std::vector<X3<F>, aligned_allocator<X3<F>>> stubinv1, stub2;
+  if (xbin) {
+    if (!stubs1.size() || !stubs2.size())
+      throw std::runtime_error("scoring needs stubs1 and stubs2");
+    auto s1 = xform_py_to_eigen(stubs1), s2 = xform_py_to_eigen(stubs2);
+    if ((int)s1.size() <= bvh_max_id(bvh1) ||
+        (int)s2.size() <= bvh_max_id(bvh2))
+      throw std::runtime_error("stubs must cover all object ids in bvh");
+    for (size_t i = 0; i < s1.size(); ++i) stubinv1.push_back(s1[i].inverse());
+    stub2.assign(s2.begin(), s2.end());
+  }
+  size_t ndir = dirns.rows(), n = ori.size() * ndir;
+  std::vector<DockHit> top;
+  {
+    py::gil_scoped_release release;
+    DockHeap best;
+    std::mutex bestmtx;
+    nthread = resolve_nthread(nthread, n);
+    size_t chunk = std::max<size_t>(64, n / (8 * nthread));
+    size_t nchunk = (n + chunk - 1) / chunk;
+    parallel_for(
+        nchunk,
+        [&](size_t ichunk) {
+          DockHeap local;
+          size_t end = std::min(n, (ichunk + 1) * chunk);
+          for (size_t j = ichunk * chunk; j < end; ++j) {
+            int i = j / ndir, k = j % ndir;
+            V3<F> dir = dirns.row(k).transpose().normalized();
+            X3<F> x2inv = ori[i].inverse();
+            BVMinAxis<F> slide(x2inv.rotation() * dir, x2inv, rad);
+            F d = hgeom::bvh::BVMinimize(bvh2, bvh1, slide);
+            if (d >= 9e8) continue;
+            X3<F> x2 = ori[i];
+            x2.translation() += d * dir;
+            BVHDockScore<F, V> query(contact_dist, x2);
+            if (xbin) {
+              query.xbin = xbin;
+              query.map = phmap;
+              query.stubinv1 = stubinv1.data();
+              query.stub2 = stub2.data();
+            }
+            hgeom::bvh::BVIntersect(bvh1, bvh2, query);
+            DockHit h{xbin ? query.score : query.ncontact, query.ncontact, i,
+                      k, d};
+            dock_keep(local, h, topk);
+          }
+          std::lock_guard<std::mutex> lock(bestmtx);
+          for (; !local.empty(); local.pop()) dock_keep(best, local.top(), topk);
+        },
+        nthread, 1);
+    for (; !best.empty(); best.pop()) top.push_back(best.top());
+    std::reverse(top.begin(), top.end());
+  }
+  size_t nout = top.size();
+  Vx<double> score(nout);
+  Vx<int> ncontact(nout), iori(nout), idir(nout);
+  auto pos = std::make_unique<Vx<X3<F>>>(nout);
+  for (size_t m = 0; m < nout; ++m) {
+    score[m] = top[m].score;
+    ncontact[m] = top[m].ncontact;
+    iori[m] = top[m].iori;
+    idir[m] = top[m].idir;
+    X3<F> x = ori[top[m].iori];
+    x.translation() +=
+        (F)top[m].slide * dirns.row(top[m].idir).transpose().normalized();
+    (*pos)[m] = x;
+  }
+  return py::make_tuple(std::move(score), std::move(ncontact),
+                        xform_eigenptr_to_py(std::move(pos)), std::move(iori),
+                        std::move(idir));
+}
+
+/*
+ray casting. each object is hit as a sphere of radius rad around it (plus
+its own radius for SphIdx objects). rays are the homog (4,2) origin,
+direction columns. first hit keeps shrinking tmax as hits are found so later
+volumes are pruned, any hit stops at the first object within tmax
+*/
+template <typename F> struct BVHRayQuery {
+  using Scalar = F;
+  V3<F> orig, dir;
+  F rad, tmax;
+  bool anyhit;
+  int idx = -1;
+  BVHRayQuery(V3<F> o, V3<F> d, F r, F maxdist, bool any)
+      : orig(o), dir(d.normalized()), rad(r), tmax(maxdist), anyhit(any) {}
+  // entry distance along the ray into sphere cen, r, or -1 if it misses.
+  // 0 if orig is inside
+  F entry(V3<F> const &cen, F r) const {
+    V3<F> m = orig - cen;
+    F b = m.dot(dir), c = m.squaredNorm() - r * r;
+    if (c <= 0) return 0;
+    if (b > 0) return -1;
+    F disc = b * b - c;
+    if (disc < 0) return -1;
+    return -b - std::sqrt(disc);
+  }
+  bool hit(V3<F> const &cen, F r) const {
+    F t = entry(cen, r);
+    return t >= 0 && t < tmax;
+  }
+  bool intersectVolume(Sphere<F> vol) { return hit(vol.cen, vol.rad + rad); }
+  bool intersectObject(PtIdx<F> obj) { return object(obj.pos, rad, obj.idx); }
+  bool intersectObject(SphIdx<F> obj) {
+    return object(obj.pos, rad + obj.rad, obj.idx);
+  }
+  bool object(V3<F> const &cen, F r, int i) {
+    F t = entry(cen, r);
+    if (t < 0 || t >= tmax) return false;
+    tmax = t;
+    idx = i;
+    return anyhit;
+  }
+};
+
+template <typename F>
+using RayArray = py::array_t<F, py::array::c_style | py::array::forcecast>;
+template <typename F>
+void rays_py_to_eigen(RayArray<F> const &rays, std::vector<V3<F>> &orig,
+                      std::vector<V3<F>> &dir,
+                      std::vector<py::ssize_t> &shape) {
+  if (rays.ndim() < 2 || rays.shape(rays.ndim() - 2) != 4 ||
+      rays.shape(rays.ndim() - 1) != 2)
+    throw std::runtime_error("argument 'rays' shape must be (..., 4, 2)");
+  shape.assign(rays.shape(), rays.shape() + rays.ndim() - 2);
+  size_t n = rays.size() / 8;
+  F const *p = rays.data();
+  orig.resize(n);
+  dir.resize(n);
+  for (size_t i = 0; i < n; ++i, p += 8) {
+    orig[i] = V3<F>(p[0], p[2], p[4]);
+    dir[i] = V3<F>(p[1], p[3], p[5]);
+  }
+}
+
+template <typename F, typename Tree = BVH<F>>
+py::tuple bvh_raycast(Tree &bvh, RayArray<F> rays, F radius, M4<F> pose,
+                      F maxdist, int nthread) {
+  std::vector<V3<F>> orig, dir;
+  std::vector<py::ssize_t> shape;
+  rays_py_to_eigen<F>(rays, orig, dir, shape);
+  py::array_t<F> dist(shape);
+  py::array_t<int> idx(shape);
+  F *pd = dist.mutable_data();
+  int *pi = idx.mutable_data();
+  {
+    py::gil_scoped_release release;
+    X3<F> inv = X3<F>(pose).inverse();
+    parallel_for(
+        orig.size(),
+        [&](size_t i) {
+          BVHRayQuery<F> query(inv * orig[i], inv.linear() * dir[i], radius,
+                               maxdist, false);
+          hgeom::bvh::BVIntersect(bvh, query);
+          pd[i] = query.idx < 0 ? std::numeric_limits<F>::infinity()
+                                : query.tmax;
+          pi[i] = query.idx;
+        },
+        nthread);
+  }
+  return py::make_tuple(std::move(dist), std::move(idx));
+}
+template <typename F, typename Tree = BVH<F>>
+py::array_t<bool> bvh_raycast_any(Tree &bvh, RayArray<F> rays, F radius,
+                                  M4<F> pose, F maxdist, int nthread) {
+  std::vector<V3<F>> orig, dir;
+  std::vector<py::ssize_t> shape;
+  rays_py_to_eigen<F>(rays, orig, dir, shape);
+  py::array_t<bool> out(shape);
+  bool *po = out.mutable_data();
+  {
+    py::gil_scoped_release release;
+    X3<F> inv = X3<F>(pose).inverse();
+    parallel_for(
+        orig.size(),
+        [&](size_t i) {
+          BVHRayQuery<F> query(inv * orig[i], inv.linear() * dir[i], radius,
+                               maxdist, true);
+          hgeom::bvh::BVIntersect(bvh, query);
+          po[i] = query.idx >= 0;
+        },
+        nthread);
+  }
+  return out;
 }
 
 template <typename F> int bvh_print(BVH<F> &bvh) {
@@ -1080,6 +3085,13 @@ template <typename F> V4<F> bvh_obj_com(BVH<F> &b) {
   return com;
 }
 
+template <typename Tree> py::dict bvh_quality(Tree const &bvh) {
+  BVHQuality q = bvh.quality();
+  return py::dict("nvol"_a = q.nvol, "maxdepth"_a = q.maxdepth,
+                  "meandepth"_a = q.meandepth, "sumrad"_a = q.sumrad,
+                  "overlap"_a = q.overlap);
+}
+
 template <typename F> py::tuple BVH_get_state(BVH<F> const &bvh) {
   Vx<int> child(bvh.child.size());
   for (int i = 0; i < bvh.child.size(); ++i)
@@ -1103,7 +3115,8 @@ template <typename F> py::tuple BVH_get_state(BVH<F> const &bvh) {
   Vx<int> idx(bvh.objs.size());
   for (int i = 0; i < bvh.objs.size(); ++i)
     idx[i] = bvh.objs[i].idx;
-  return py::make_tuple(child, sph, lbub, pos, idx);
+  return py::make_tuple(std::move(child), std::move(sph), std::move(lbub),
+                        std::move(pos), std::move(idx));
 }
 template <typename F> std::unique_ptr<BVH<F>> bvh_set_state(py::tuple state) {
   auto bvh = std::make_unique<BVH<F>>();
@@ -1132,12 +3145,13 @@ template <typename F> std::unique_ptr<BVH<F>> bvh_set_state(py::tuple state) {
     pt.idx = idx[i];
     bvh->objs.push_back(pt);
   }
+  bvh_refit_id_bounds(*bvh);
   return bvh;
 }
 template <typename F> void bind_bvh(pybind11::module_ m, std::string name) {
   py::class_<BVH<F>>(m, name.c_str())
-      .def(py::init(&bvh_create<F>), "coords"_a, "which"_a = Vx<bool>(),
-           "ids"_a = Vx<int>())
+      .def(py::init(&bvh_create<F>), "coords"_a, "which"_a = py::none(),
+           "ids"_a = py::array_t<int>(), "bound"_a = "welzl")
       .def("__len__", [](BVH<F> &b) { return b.objs.size(); })
       .def("radius", [](BVH<F> &b) { return b.vols[b.getRootIndex()].rad; })
       .def("center", [](BVH<F> &b) { return b.vols[b.getRootIndex()].cen; })
@@ -1149,25 +3163,196 @@ template <typename F> void bind_bvh(pybind11::module_ m, std::string name) {
       .def("obj_id", &bvh_obj_ids<F>)
       .def("vol_lb", &bvh_vol_lbs<F>)
       .def("vol_ub", &bvh_vol_ubs<F>)
+      .def("quality", &bvh_quality<BVH<F>>)
       .def(py::pickle(
           [](const BVH<F> &bvh) { return BVH_get_state<F>((BVH<F> &)bvh); },
           [](py::tuple t) { return bvh_set_state<F>(t); }))
       /**/;
 }
+template <typename F>
+void bind_lazy_bvh(pybind11::module_ m, std::string name) {
+  py::class_<LazyBVH<F>>(m, name.c_str())
+      .def(py::init(&bvh_create_lazy<F>), "coords"_a, "which"_a = py::none(),
+           "ids"_a = py::array_t<int>(), "levels"_a = 8)
+      .def("__len__", [](LazyBVH<F> &b) { return b.objs.size(); })
+      .def("radius", [](LazyBVH<F> &b) { return b.vols[b.getRootIndex()].rad; })
+      .def("center", [](LazyBVH<F> &b) { return b.vols[b.getRootIndex()].cen; })
+      .def("nbuilt", &LazyBVH<F>::nbuilt)
+      .def("nexpanded", &LazyBVH<F>::nexpanded)
+      .def("expand_all", &LazyBVH<F>::expand_all, nogil())
+      /**/;
+}
+template <typename F>
+void bvh_dynamic_insert(DynamicBVH<F> &bvh, py::array_t<F> coords,
+                        py::array_t<int> ids) {
+  if (coords.ndim() != 2 || coords.shape(1) != 3)
+    throw std::runtime_error("argument 'coords' shape must be (N, 3)");
+  if (ids.ndim() != 1 || ids.shape(0) != coords.shape(0))
+    throw std::runtime_error(
+        "argument 'ids' shape must be (N,) matching coord shape");
+  auto c = coords.template unchecked<2>();
+  auto id = ids.template unchecked<1>();
+  py::gil_scoped_release release;
+  for (py::ssize_t i = 0; i < c.shape(0); ++i)
+    bvh.insert(PtIdx<F>(V3<F>(c(i, 0), c(i, 1), c(i, 2)), id(i)));
+}
+template <typename F>
+int bvh_dynamic_remove(DynamicBVH<F> &bvh, py::array_t<int> ids) {
+  auto id = ids.template unchecked<1>();
+  py::gil_scoped_release release;
+  int n = 0;
+  for (py::ssize_t i = 0; i < id.shape(0); ++i)
+    n += bvh.remove(id(i));
+  return n;
+}
+template <typename F>
+void bind_dynamic_bvh(pybind11::module_ m, std::string name) {
+  py::class_<DynamicBVH<F>>(m, name.c_str())
+      .def(py::init<>())
+      .def(py::init(&bvh_create_tree<DynamicBVH<F>>), "coords"_a,
+           "which"_a = py::none(), "ids"_a = py::array_t<int>())
+      .def("insert", &bvh_dynamic_insert<F>, "coords"_a, "ids"_a)
+      .def("remove", &bvh_dynamic_remove<F>, "ids"_a)
+      .def("__len__", [](DynamicBVH<F> &b) { return b.objs.size(); })
+      .def("radius",
+           [](DynamicBVH<F> &b) { return b.vols[b.getRootIndex()].rad; })
+      .def("center",
+           [](DynamicBVH<F> &b) { return b.vols[b.getRootIndex()].cen; })
+      .def("height", &DynamicBVH<F>::height)
+      .def("quality", &bvh_quality<DynamicBVH<F>>)
+      .def("check", &DynamicBVH<F>::check)
+      /**/;
+}
+template <typename F, typename Tree>
+py::class_<Tree> bind_radius_bvh(pybind11::module_ m, std::string name) {
+  return py::class_<Tree>(m, name.c_str())
+      .def("__len__", [](Tree &b) { return b.objs.size(); })
+      .def("radius", [](Tree &b) { return b.vols[b.getRootIndex()].rad; })
+      .def("quality", &bvh_quality<Tree>)
+      .def("center", [](Tree &b) { return b.vols[b.getRootIndex()].cen; })
+      .def("obj_id",
+           [](Tree &b) {
+             Vx<int> x(b.objs.size());
+             for (int i = 0; i < x.size(); ++i) x[i] = b.objs[i].idx;
+             return x;
+           })
+      .def("vol_lb",
+           [](Tree &b) {
+             Vx<int> x(b.vols.size());
+             for (int i = 0; i < x.size(); ++i) x[i] = b.vols[i].lb;
+             return x;
+           })
+      .def("vol_ub",
+           [](Tree &b) {
+             Vx<int> x(b.vols.size());
+             for (int i = 0; i < x.size(); ++i) x[i] = b.vols[i].ub;
+             return x;
+           })
+      .def("obj_radius",
+           [](Tree &b) {
+             Vx<F> x(b.objs.size());
+             for (int i = 0; i < x.size(); ++i) x[i] = b.objs[i].rad;
+             return x;
+           })
+      /**/;
+}
+template <typename F, typename V> void bind_dock(pybind11::module_ m) {
+  m.def("bvh_dock", &bvh_dock<F, V>,
+        "slide into contact, count contacts, score, keep the top k",
+        "bvh1"_a, "bvh2"_a, "oris"_a, "dirns"_a, "rad"_a, "contact_dist"_a,
+        "topk"_a = 100, "xbin"_a = py::none(), "phmap"_a = py::none(),
+        "stubs1"_a = py::array_t<F>(), "stubs2"_a = py::array_t<F>(),
+        "nthread"_a = 0);
+}
+template <typename F, typename Tree>
+void bind_raycast(pybind11::module_ m) {
+  m.def("bvh_raycast", &bvh_raycast<F, Tree>,
+        "first hit distance and id per ray, inf and -1 on a miss", "bvh"_a,
+        "rays"_a, "radius"_a = 0, "pose"_a = M4<F>::Identity(),
+        "maxdist"_a = std::numeric_limits<F>::infinity(), "nthread"_a = 0);
+  m.def("bvh_raycast_any", &bvh_raycast_any<F, Tree>,
+        "whether each ray hits anything within maxdist", "bvh"_a, "rays"_a,
+        "radius"_a = 0, "pose"_a = M4<F>::Identity(),
+        "maxdist"_a = std::numeric_limits<F>::infinity(), "nthread"_a = 0);
+}
+// query overloads for the other tree types, on either side
+template <typename F, typename BVH1, typename BVH2>
+void bind_tree_queries(pybind11::module_ m) {
+  m.def("bvh_min_dist", &bvh_min_dist<F, BVH1, BVH2>, "bvh1"_a, "bvh2"_a,
+        "pos1"_a, "pos2"_a, "eps"_a = 0);
+  m.def("bvh_min_dist_vec", &bvh_min_dist_vec<F, BVH1, BVH2>, "bvh1"_a,
+        "bvh2"_a, "pos1"_a, "pos2"_a, "eps"_a = 0);
+  m.def("bvh_isect", &bvh_isect<F, BVH1, BVH2>, "bvh1"_a, "bvh2"_a, "pos1"_a,
+        "pos2"_a, "mindist"_a);
+  m.def("bvh_isect_vec", &bvh_isect_vec<F, BVH1, BVH2>, "bvh1"_a, "bvh2"_a,
+        "pos1"_a, "pos2"_a, "mindist"_a);
+  m.def("bvh_count_pairs", &bvh_count_pairs<F, BVH1, BVH2>);
+  m.def("bvh_count_pairs_vec", &bvh_count_pairs_vec<F, BVH1, BVH2>);
+  m.def("bvh_collect_pairs_vec", &bvh_collect_pairs_vec<F, F, BVH1, BVH2>);
+}
 
 PYBIND11_MODULE(_bvh, m) {
   bind_bvh<float>(m, "SphereBVH_float");
   bind_bvh<double>(m, "SphereBVH_double");
-
-  m.def("bvh_min_dist", &bvh_min_dist<double>, "min pair distance", "bvh1"_a,
-        "bvh2"_a, "pos1"_a, "pos2"_a);
-  m.def("bvh_min_dist", &bvh_min_dist<float>, "min pair distance", "bvh1"_a,
-        "bvh2"_a, "pos1"_a, "pos2"_a);
-
-  m.def("bvh_min_dist_vec", &bvh_min_dist_vec<double>, "min pair distance",
-        "bvh1"_a, "bvh2"_a, "pos1"_a, "pos2"_a);
-  m.def("bvh_min_dist_vec", &bvh_min_dist_vec<float>, "min pair distance",
-        "bvh1"_a, "bvh2"_a, "pos1"_a, "pos2"_a);
+  m.def("bvh_set_cache_dir", &bvh_set_cache_dir,
+        "set the on-disk SphereBVH cache directory, '' disables. returns the "
+        "previous one",
+        "dir"_a);
+  m.def("bvh_cache_stats", &bvh_cache_stats);
+  bind_lazy_bvh<float>(m, "LazySphereBVH_float");
+  bind_lazy_bvh<double>(m, "LazySphereBVH_double");
+  bind_tree_queries<float, LazyBVH<float>, BVH<float>>(m);
+  bind_tree_queries<float, BVH<float>, LazyBVH<float>>(m);
+  bind_tree_queries<float, LazyBVH<float>, LazyBVH<float>>(m);
+  bind_tree_queries<double, LazyBVH<double>, BVH<double>>(m);
+  bind_tree_queries<double, BVH<double>, LazyBVH<double>>(m);
+  bind_tree_queries<double, LazyBVH<double>, LazyBVH<double>>(m);
+  m.def("bvh_min_dist_one", &bvh_min_dist_one<float, LazyBVH<float>>);
+  m.def("bvh_min_dist_one", &bvh_min_dist_one<double, LazyBVH<double>>);
+  bind_dynamic_bvh<float>(m, "DynamicSphereBVH_float");
+  bind_dynamic_bvh<double>(m, "DynamicSphereBVH_double");
+  bind_tree_queries<float, DynamicBVH<float>, BVH<float>>(m);
+  bind_tree_queries<float, BVH<float>, DynamicBVH<float>>(m);
+  bind_tree_queries<float, DynamicBVH<float>, DynamicBVH<float>>(m);
+  bind_tree_queries<double, DynamicBVH<double>, BVH<double>>(m);
+  bind_tree_queries<double, BVH<double>, DynamicBVH<double>>(m);
+  bind_tree_queries<double, DynamicBVH<double>, DynamicBVH<double>>(m);
+  m.def("bvh_min_dist_one", &bvh_min_dist_one<float, DynamicBVH<float>>);
+  m.def("bvh_min_dist_one", &bvh_min_dist_one<double, DynamicBVH<double>>);
+  bind_radius_bvh<float, SphBVH<float>>(m, "SphereRadBVH_float")
+      .def(py::init(&bvh_create_spheres<float>), "coords"_a, "radii"_a,
+           "ids"_a = py::array_t<int>(), "bound"_a = "welzl");
+  bind_radius_bvh<double, SphBVH<double>>(m, "SphereRadBVH_double")
+      .def(py::init(&bvh_create_spheres<double>), "coords"_a, "radii"_a,
+           "ids"_a = py::array_t<int>(), "bound"_a = "welzl");
+  bind_radius_bvh<float, CapBVH<float>>(m, "CapsuleBVH_float")
+      .def(py::init(&bvh_create_capsules<float>), "ends"_a, "radii"_a,
+           "ids"_a = py::array_t<int>(), "bound"_a = "welzl");
+  bind_radius_bvh<double, CapBVH<double>>(m, "CapsuleBVH_double")
+      .def(py::init(&bvh_create_capsules<double>), "ends"_a, "radii"_a,
+           "ids"_a = py::array_t<int>(), "bound"_a = "welzl");
+  bind_tree_queries<float, SphBVH<float>, SphBVH<float>>(m);
+  bind_tree_queries<float, CapBVH<float>, CapBVH<float>>(m);
+  bind_tree_queries<float, SphBVH<float>, CapBVH<float>>(m);
+  bind_tree_queries<float, CapBVH<float>, SphBVH<float>>(m);
+  bind_tree_queries<double, SphBVH<double>, SphBVH<double>>(m);
+  bind_tree_queries<double, CapBVH<double>, CapBVH<double>>(m);
+  bind_tree_queries<double, SphBVH<double>, CapBVH<double>>(m);
+  bind_tree_queries<double, CapBVH<double>, SphBVH<double>>(m);
+
+  m.def("bvh_min_dist", &bvh_min_dist<double>,
+        "min pair distance, within eps of exact", "bvh1"_a, "bvh2"_a,
+        "pos1"_a, "pos2"_a, "eps"_a = 0);
+  m.def("bvh_min_dist", &bvh_min_dist<float>,
+        "min pair distance, within eps of exact", "bvh1"_a, "bvh2"_a,
+        "pos1"_a, "pos2"_a, "eps"_a = 0);
+
+  m.def("bvh_min_dist_vec", &bvh_min_dist_vec<double>,
+        "min pair distance, within eps of exact", "bvh1"_a, "bvh2"_a,
+        "pos1"_a, "pos2"_a, "eps"_a = 0);
+  m.def("bvh_min_dist_vec", &bvh_min_dist_vec<float>,
+        "min pair distance, within eps of exact", "bvh1"_a, "bvh2"_a,
+        "pos1"_a, "pos2"_a, "eps"_a = 0);
 
   m.def("bvh_min_dist_fixed", &bvh_min_dist_fixed<double>);
   m.def("bvh_min_dist_fixed", &bvh_min_dist_fixed<float>);
@@ -1186,6 +3371,12 @@ PYBIND11_MODULE(_bvh, m) {
         "bvh2"_a, "pos1"_a, "pos2"_a, "mindist"_a);
   m.def("bvh_isect_vec", &bvh_isect_vec<double>, "intersction test", "bvh1"_a,
         "bvh2"_a, "pos1"_a, "pos2"_a, "mindist"_a);
+  m.def("bvh_isect_bodies", &bvh_isect_bodies<float>,
+        "intersecting pairs among placed bodies", "bodies"_a, "poses"_a,
+        "mindist"_a, "nthread"_a = 0);
+  m.def("bvh_isect_bodies", &bvh_isect_bodies<double>,
+        "intersecting pairs among placed bodies", "bodies"_a, "poses"_a,
+        "mindist"_a, "nthread"_a = 0);
 
   m.def("bvh_isect_fixed", &bvh_isect_fixed<float>);
   m.def("bvh_isect_fixed", &bvh_isect_fixed<double>);
@@ -1221,6 +3412,14 @@ PYBIND11_MODULE(_bvh, m) {
   m.def("bvh_isect_range", &bvh_isect_range<double>, "intersction test",
         "bvh1"_a, "bvh2"_a, "pos1"_a, "pos2"_a, "mindist"_a, "maxtrim"_a = -1,
         "maxtrim_lb"_a = -1, "maxtrim_ub"_a = -1, "nasym1"_a = -1);
+  m.def("bvh_isect_range_warm", &bvh_isect_range_warm<float>,
+        "parallel warm started isect range", "bvh1"_a, "bvh2"_a, "pos1"_a,
+        "pos2"_a, "mindist"_a, "maxtrim"_a = -1, "maxtrim_lb"_a = -1,
+        "maxtrim_ub"_a = -1, "nasym1"_a = -1, "nthread"_a = 0, "chunk"_a = 0);
+  m.def("bvh_isect_range_warm", &bvh_isect_range_warm<double>,
+        "parallel warm started isect range", "bvh1"_a, "bvh2"_a, "pos1"_a,
+        "pos2"_a, "mindist"_a, "maxtrim"_a = -1, "maxtrim_lb"_a = -1,
+        "maxtrim_ub"_a = -1, "nasym1"_a = -1, "nthread"_a = 0, "chunk"_a = 0);
 
   m.def("naive_bvh_isect_range", &naive_bvh_isect_range<double>,
         "intersction test", "bvh1"_a, "bvh2"_a, "pos1"_a, "pos2"_a,
@@ -1234,6 +3433,22 @@ PYBIND11_MODULE(_bvh, m) {
         "bvh2"_a, "pos1"_a, "pos2"_a, "rad"_a, "dirn"_a);
   m.def("bvh_slide_vec", &bvh_slide_vec<double>, "slide into contact", "bvh1"_a,
         "bvh2"_a, "pos1"_a, "pos2"_a, "rad"_a, "dirn"_a);
+  m.def("bvh_slide_multi_vec", &bvh_slide_multi_vec<float>,
+        "slide into contact along many directions", "bvh1"_a, "bvh2"_a,
+        "pos1"_a, "pos2"_a, "rad"_a, "dirns"_a, "nthread"_a = 0);
+  m.def("bvh_slide_multi_vec", &bvh_slide_multi_vec<double>,
+        "slide into contact along many directions", "bvh1"_a, "bvh2"_a,
+        "pos1"_a, "pos2"_a, "rad"_a, "dirns"_a, "nthread"_a = 0);
+  m.def("bvh_slide_rot", &bvh_slide_rot<float>, "rotate into contact",
+        "bvh1"_a, "bvh2"_a, "pos1"_a, "pos2"_a, "rad"_a, "axis"_a, "cen"_a);
+  m.def("bvh_slide_rot", &bvh_slide_rot<double>, "rotate into contact",
+        "bvh1"_a, "bvh2"_a, "pos1"_a, "pos2"_a, "rad"_a, "axis"_a, "cen"_a);
+  m.def("bvh_slide_rot_vec", &bvh_slide_rot_vec<float>, "rotate into contact",
+        "bvh1"_a, "bvh2"_a, "pos1"_a, "pos2"_a, "rad"_a, "axis"_a, "cen"_a,
+        "nthread"_a = 0);
+  m.def("bvh_slide_rot_vec", &bvh_slide_rot_vec<double>, "rotate into contact",
+        "bvh1"_a, "bvh2"_a, "pos1"_a, "pos2"_a, "rad"_a, "axis"_a, "cen"_a,
+        "nthread"_a = 0);
 
   // m.def("bvh_slide_32bit", &bvh_slide<float>, "slide into contact",
   // "bvh1"_a, "bvh2"_a, "pos1"_a, "pos2"_a, "rad"_a, "dirn"_a);
@@ -1244,12 +3459,83 @@ PYBIND11_MODULE(_bvh, m) {
   m.def("bvh_collect_pairs_vec", &bvh_collect_pairs_vec<float, double>);
   m.def("bvh_collect_pairs_vec", &bvh_collect_pairs_vec<double, float>);
   m.def("bvh_collect_pairs_vec", &bvh_collect_pairs_vec<double, double>);
+  bind_collect_pairs_stream<float>(m, "BVHCollectPairsStream_float");
+  bind_collect_pairs_stream<double>(m, "BVHCollectPairsStream_double");
+  m.def("bvh_collect_pairs_iter", &bvh_collect_pairs_iter<float>,
+        "iterate collected pairs in chunks", "bvh1"_a, "bvh2"_a, "pos1"_a,
+        "pos2"_a, "maxdist"_a, "chunk"_a = 1 << 20, py::keep_alive<0, 1>(),
+        py::keep_alive<0, 2>());
+  m.def("bvh_collect_pairs_iter", &bvh_collect_pairs_iter<double>,
+        "iterate collected pairs in chunks", "bvh1"_a, "bvh2"_a, "pos1"_a,
+        "pos2"_a, "maxdist"_a, "chunk"_a = 1 << 20, py::keep_alive<0, 1>(),
+        py::keep_alive<0, 2>());
+  m.def("bvh_collect_pairs_chunked", &bvh_collect_pairs_chunked<float>,
+        "pass collected pairs to callback(pairs, lbub, start) in chunks",
+        "bvh1"_a, "bvh2"_a, "pos1"_a, "pos2"_a, "maxdist"_a, "callback"_a,
+        "chunk"_a = 1 << 20);
+  m.def("bvh_collect_pairs_chunked", &bvh_collect_pairs_chunked<double>,
+        "pass collected pairs to callback(pairs, lbub, start) in chunks",
+        "bvh1"_a, "bvh2"_a, "pos1"_a, "pos2"_a, "maxdist"_a, "callback"_a,
+        "chunk"_a = 1 << 20);
+  m.def("bvh_collect_pairs_npy", &bvh_collect_pairs_npy<float>,
+        "stream collected pairs to an .npy file", "bvh1"_a, "bvh2"_a, "pos1"_a,
+        "pos2"_a, "maxdist"_a, "fname"_a, "chunk"_a = 1 << 20);
+  m.def("bvh_collect_pairs_npy", &bvh_collect_pairs_npy<double>,
+        "stream collected pairs to an .npy file", "bvh1"_a, "bvh2"_a, "pos1"_a,
+        "pos2"_a, "maxdist"_a, "fname"_a, "chunk"_a = 1 << 20);
   m.def("naive_collect_pairs", &naive_collect_pairs<float>);
   m.def("naive_collect_pairs", &naive_collect_pairs<double>);
   m.def("bvh_count_pairs", &bvh_count_pairs<float>);
   m.def("bvh_count_pairs", &bvh_count_pairs<double>);
   m.def("bvh_count_pairs_vec", &bvh_count_pairs_vec<float>);
   m.def("bvh_count_pairs_vec", &bvh_count_pairs_vec<double>);
+  m.def("bvh_count_pairs_hist", &bvh_count_pairs_hist<float>,
+        "count pairs in distance bins", "bvh1"_a, "bvh2"_a, "pos1"_a, "pos2"_a,
+        "bin_edges"_a, "nthread"_a = 0);
+  m.def("bvh_count_pairs_hist", &bvh_count_pairs_hist<double>,
+        "count pairs in distance bins", "bvh1"_a, "bvh2"_a, "pos1"_a, "pos2"_a,
+        "bin_edges"_a, "nthread"_a = 0);
+  m.def("bvh_multi_query_vec", &bvh_multi_query_vec<float>,
+        "isect, min dist and pair count in one traversal", "bvh1"_a, "bvh2"_a,
+        "pos1"_a, "pos2"_a, "mindist"_a, "maxdist"_a, "nthread"_a = 0);
+  m.def("bvh_multi_query_vec", &bvh_multi_query_vec<double>,
+        "isect, min dist and pair count in one traversal", "bvh1"_a, "bvh2"_a,
+        "pos1"_a, "pos2"_a, "mindist"_a, "maxdist"_a, "nthread"_a = 0);
+  m.def("bvh_all_nearest_vec", &bvh_all_nearest_vec<float>,
+        "nearest bvh2 object for every bvh1 object", "bvh1"_a, "bvh2"_a,
+        "pos1"_a, "pos2"_a, "nthread"_a = 0);
+  m.def("bvh_all_nearest_vec", &bvh_all_nearest_vec<double>,
+        "nearest bvh2 object for every bvh1 object", "bvh1"_a, "bvh2"_a,
+        "pos1"_a, "pos2"_a, "nthread"_a = 0);
+  m.def("bvh_hausdorff_vec", &bvh_hausdorff_vec<float>,
+        "symmetric hausdorff distance", "bvh1"_a, "bvh2"_a, "pos1"_a, "pos2"_a,
+        "nthread"_a = 0);
+  m.def("bvh_hausdorff_vec", &bvh_hausdorff_vec<double>,
+        "symmetric hausdorff distance", "bvh1"_a, "bvh2"_a, "pos1"_a, "pos2"_a,
+        "nthread"_a = 0);
+  m.def("bvh_isect_sym_vec", &bvh_isect_sym_vec<float>,
+        "asu vs all symmetric copies intersection test", "bvh"_a, "pos"_a,
+        "syms"_a, "mindist"_a, "nthread"_a = 0);
+  m.def("bvh_isect_sym_vec", &bvh_isect_sym_vec<double>,
+        "asu vs all symmetric copies intersection test", "bvh"_a, "pos"_a,
+        "syms"_a, "mindist"_a, "nthread"_a = 0);
+  m.def("bvh_count_pairs_sym_vec", &bvh_count_pairs_sym_vec<float>,
+        "asu vs each symmetric copy contact count", "bvh"_a, "pos"_a, "syms"_a,
+        "maxdist"_a, "nthread"_a = 0);
+  m.def("bvh_count_pairs_sym_vec", &bvh_count_pairs_sym_vec<double>,
+        "asu vs each symmetric copy contact count", "bvh"_a, "pos"_a, "syms"_a,
+        "maxdist"_a, "nthread"_a = 0);
+
+  m.def("bvh_score_pairs_binned", &bvh_score_pairs_binned<float>,
+        "sum binned pair energies inside traversal", "bvh1"_a, "bvh2"_a,
+        "pos1"_a, "pos2"_a, "maxdist"_a, "types1"_a, "types2"_a, "table"_a,
+        "per_res"_a = false, "nthread"_a = 0);
+  m.def("bvh_score_pairs_binned", &bvh_score_pairs_binned<double>,
+        "sum binned pair energies inside traversal", "bvh1"_a, "bvh2"_a,
+        "pos1"_a, "pos2"_a, "maxdist"_a, "types1"_a, "types2"_a, "table"_a,
+        "per_res"_a = false, "nthread"_a = 0);
+  m.def("naive_score_pairs_binned", &naive_score_pairs_binned<float>);
+  m.def("naive_score_pairs_binned", &naive_score_pairs_binned<double>);
 
   m.def("bvh_print", &bvh_print<float>);
   m.def("bvh_print", &bvh_print<double>);
@@ -1257,6 +3543,15 @@ PYBIND11_MODULE(_bvh, m) {
   m.def("bvh_min_dist_one", &bvh_min_dist_one<float>);
   m.def("bvh_min_dist_one", &bvh_min_dist_one<double>);
 
+  bind_dock<float, float>(m);
+  bind_dock<float, double>(m);
+  bind_dock<double, float>(m);
+  bind_dock<double, double>(m);
+  bind_raycast<float, BVH<float>>(m);
+  bind_raycast<double, BVH<double>>(m);
+  bind_raycast<float, SphBVH<float>>(m);
+  bind_raycast<double, SphBVH<double>>(m);
+
   Vx<int> lb0(1), ub0(1);
   lb0[0] = NL<int>::min();
   ub0[0] = NL<int>::max();
@@ -1276,6 +3571,21 @@ PYBIND11_MODULE(_bvh, m) {
         &bvh_collect_pairs_range_vec<float, double>, "bvh1"_a, "bvh2"_a,
         "pos1"_a, "pos2"_a, "maxdist"_a, "lb1"_a = lb0, "ub1"_a = ub0,
         "nasym1"_a = -1, "lb2"_a = lb0, "ub2"_a = ub0, "nasym2"_a = -1);
+
+  m.def("bvh_isect_mask_vec", &bvh_isect_mask_vec<float>,
+        "intersection test restricted to masked ids", "bvh1"_a, "bvh2"_a,
+        "pos1"_a, "pos2"_a, "mindist"_a, "mask1"_a, "mask2"_a,
+        "nthread"_a = 0);
+  m.def("bvh_isect_mask_vec", &bvh_isect_mask_vec<double>,
+        "intersection test restricted to masked ids", "bvh1"_a, "bvh2"_a,
+        "pos1"_a, "pos2"_a, "mindist"_a, "mask1"_a, "mask2"_a,
+        "nthread"_a = 0);
+  m.def("bvh_collect_pairs_mask_vec", &bvh_collect_pairs_mask_vec<float>,
+        "collect pairs restricted to masked ids", "bvh1"_a, "bvh2"_a, "pos1"_a,
+        "pos2"_a, "maxdist"_a, "mask1"_a, "mask2"_a);
+  m.def("bvh_collect_pairs_mask_vec", &bvh_collect_pairs_mask_vec<double>,
+        "collect pairs restricted to masked ids", "bvh1"_a, "bvh2"_a, "pos1"_a,
+        "pos2"_a, "maxdist"_a, "mask1"_a, "mask2"_a);
 }
 
 } // namespace bvh
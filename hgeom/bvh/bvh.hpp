@@ -8,7 +8,13 @@
 #include <Eigen/Geometry>
 #include <Eigen/StdVector>
 #include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <queue>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
 
 #include "hgeom/bvh/bvh_algo.hpp"
 #include "hgeom/geom/primitive.hpp"
@@ -79,6 +85,21 @@ template <typename F, bool idrange = false> struct WelzlBoundingSphere {
     }
 };
 
+/** How SphereBVH bounds each internal node. welzl is the exact minimal sphere
+ * of the subtree (via the BoundingSphere policy, Miniball for the ND trees),
+ * merge encloses the two child spheres, ritter and central are O(n)
+ * approximations over the subtree. central is 3D only. merge is cheapest to
+ * build but grows loosest toward the root */
+enum class BoundMethod { welzl, merge, ritter, central };
+
+/** summary of how tight a built tree is, see SphereBVH::quality */
+struct BVHQuality {
+    int nvol = 0, maxdepth = 0;
+    double meandepth = 0; // mean depth of the objects
+    double sumrad = 0;    // sum of internal node radii
+    double overlap = 0;   // sum of r1 + r2 - dist over overlapping siblings
+};
+
 template <typename _Scalar, typename _Object, int _DIM = 3,
           typename _Volume = Sphere<_Scalar>,
           typename BoundingSphere = WelzlBoundingSphere<_Scalar, true>>
@@ -101,6 +122,7 @@ class SphereBVH {
                             // vols.size() index into objs.
     Vols vols;
     Objs objs;
+    BoundMethod bound_method = BoundMethod::welzl;
 
     SphereBVH() {}
 
@@ -108,6 +130,14 @@ class SphereBVH {
         init(begin, end, 0, 0);
     } // int is recognized by init as not being an iterator type
 
+    /** nthread > 1 builds the top levels in parallel, the result does not
+     * depend on nthread */
+    template <typename Iter>
+    SphereBVH(Iter begin, Iter end, BoundMethod method, int nthread = 1)
+        : bound_method(method) {
+        init(begin, end, 0, 0, nthread);
+    }
+
     template <typename OIter, typename BIter>
     SphereBVH(OIter begin, OIter end, BIter sphbeg, BIter sphend) {
         init(begin, end, sphbeg, sphend);
@@ -126,7 +156,8 @@ class SphereBVH {
      * over their bounding vols,
      * constructs the BVH, overwriting whatever is in there currently. */
     template <typename OIter, typename BIter>
-    void init(OIter begin, OIter end, BIter sphbeg, BIter sphend) {
+    void init(OIter begin, OIter end, BIter sphbeg, BIter sphend,
+              int nthread = 1) {
         objs.clear();
         vols.clear();
         child.clear();
@@ -144,13 +175,13 @@ class SphereBVH {
         get_bvols_helper<Objs, Vols, BIter>()(objs, sphbeg, sphend, ovol);
 
         ocen.reserve(n);
-        vols.reserve(n - 1);
-        child.reserve(2 * n - 2);
+        vols.resize(n - 1);
+        child.resize(2 * n - 2);
 
         for (int i = 0; i < n; ++i) ocen.push_back(VIPair(ovol[i].cen, i));
 
         // the recursive part of the algorithm
-        build(ocen, 0, n, ovol, 0);
+        build(ocen, 0, n, ovol, 0, 0, std::max(1, nthread));
 
         Objs tmp(n);
         tmp.swap(objs);
@@ -200,6 +231,38 @@ class SphereBVH {
 
     inline const Volume &getVolume(Index index) const { return vols[index]; }
 
+    /** depth, total radius and sibling overlap of the built tree. smaller
+     * sumrad and overlap mean fewer nodes visited per query */
+    BVHQuality quality() const {
+        BVHQuality q;
+        q.nvol = (int)vols.size();
+        if (objs.size() < 2) return q;
+        int nvol = (int)vols.size();
+        auto bound = [&](int c) {
+            return c < nvol ? vols[c] : bounding_vol(objs[c - nvol]);
+        };
+        std::vector<std::pair<int, int>> stack{{getRootIndex(), 1}};
+        while (!stack.empty()) {
+            auto [index, depth] = stack.back();
+            stack.pop_back();
+            q.sumrad += vols[index].rad;
+            Volume a = bound(child[2 * index]), b = bound(child[2 * index + 1]);
+            q.overlap += std::max<double>(
+                0, a.rad + b.rad - (a.cen - b.cen).norm());
+            for (int k = 0; k < 2; ++k) {
+                int c = child[2 * index + k];
+                if (c < nvol) {
+                    stack.emplace_back(c, depth + 1);
+                } else {
+                    q.maxdepth = std::max(q.maxdepth, depth);
+                    q.meandepth += depth;
+                }
+            }
+        }
+        q.meandepth /= objs.size();
+        return q;
+    }
+
   private:
     typedef VintPair<F, DIM> VIPair;
     typedef std::vector<VIPair, Eigen::aligned_allocator<VIPair>> VIPairs;
@@ -236,16 +299,20 @@ class SphereBVH {
     // Build the part of the tree between objs[from] and objs[to] (not
     // including objs[to]). This routine partitions the ocen in [from, to) along
     // the dimension dim, recursively constructs the two halves, and adds their
-    // parent node.  TODO: a cache-friendlier layout
-    void build(VIPairs &ocen, int from, int to, Vols const &ovol,
-               int dim) noexcept {
+    // parent node. The subtree's to - from - 1 nodes fill vols[base, ...)
+    // children first, left subtree then right then the node itself, so slots
+    // are known up front and the halves can be built by separate threads.
+    // TODO: a cache-friendlier layout
+    void build(VIPairs &ocen, int from, int to, Vols const &ovol, int dim,
+               int base, int nthread) noexcept {
         eigen_assert(to - from > 1);
+        int const nobj = (int)objs.size();
+        int const node = base + (to - from) - 2;
         if (to - from == 2) {
-            auto merge =
+            vols[node] =
                 ovol[ocen[from].second].merged(ovol[ocen[from + 1].second]);
-            vols.push_back(merge);
-            child.push_back(from + (int)objs.size() - 1);
-            child.push_back(from + (int)objs.size());
+            child[2 * node] = from + nobj - 1;
+            child[2 * node + 1] = from + nobj;
         } else if (to - from == 3) {
             int mid = from + 2;
             auto subtree_objs = p1range(ocen.begin() + from, ocen.begin() + to);
@@ -257,16 +324,18 @@ class SphereBVH {
             // ocen.begin() + from, ocen.begin() + mid, ocen.begin() + to,
             // DotComparator(most_separated_points_on_AABB(subtree_objs)));
             // AxisComparator(dim));
-            build(ocen, from, mid, ovol, (dim + 1) % DIM);
-            int idx1 = (int)vols.size() - 1;
-            Volume bound = BoundingSphere::bound(subtree_objs);
-            vols.push_back(bound);
+            build(ocen, from, mid, ovol, (dim + 1) % DIM, base, 1);
+            int idx1 = base;
+            Volume bound = bound_subtree(subtree_objs, vols[idx1],
+                                         ovol[ocen[mid].second]);
+            fit_extents(bound, ocen, from, to, ovol);
+            vols[node] = bound;
             // Volume merge = vols[idx1].merged(ovol[ocen[mid].second]);
             // if (merge.rad + 0.0001 < bound.rad)
             // std::cout << "!!!!!!!!!!!!!!!!!!!!!!!!!!!!!" << std::endl;
-            // vols.push_back(bound.rad < merge.rad ? bound : merge);
-            child.push_back(idx1);
-            child.push_back(mid + (int)objs.size() - 1);
+            // vols[node] = bound.rad < merge.rad ? bound : merge;
+            child[2 * node] = idx1;
+            child[2 * node + 1] = mid + nobj - 1;
         } else {
             int mid = from + (to - from) / 2;
             auto subtree_objs = p1range(ocen.begin() + from, ocen.begin() + to);
@@ -275,20 +344,594 @@ class SphereBVH {
             nth_element(ocen.begin() + from, ocen.begin() + mid,
                         ocen.begin() + to, DotComparator(normal));
             // AxisComparator(dim));
-            build(ocen, from, mid, ovol, (dim + 1) % DIM);
-            int idx1 = (int)vols.size() - 1;
-            build(ocen, mid, to, ovol, (dim + 1) % DIM);
-            int idx2 = (int)vols.size() - 1;
-            Volume bound = BoundingSphere::bound(subtree_objs);
-            vols.push_back(bound);
+            int base2 = base + (mid - from) - 1;
+            int ndim = (dim + 1) % DIM;
+            // small subtrees aren't worth a thread
+            if (nthread > 1 && to - from > 4096) {
+                std::thread left;
+                try {
+                    left = std::thread([&] {
+                        build(ocen, from, mid, ovol, ndim, base, nthread / 2);
+                    });
+                } catch (std::system_error const &) {
+                    // out of threads, this one builds both halves
+                    build(ocen, from, mid, ovol, ndim, base, 1);
+                }
+                build(ocen, mid, to, ovol, ndim, base2, nthread - nthread / 2);
+                if (left.joinable()) left.join();
+            } else {
+                build(ocen, from, mid, ovol, ndim, base, 1);
+                build(ocen, mid, to, ovol, ndim, base2, 1);
+            }
+            int idx1 = base2 - 1;
+            int idx2 = node - 1;
+            Volume bound =
+                bound_subtree(subtree_objs, vols[idx1], vols[idx2]);
+            fit_extents(bound, ocen, from, to, ovol);
+            vols[node] = bound;
             // Volume merge = vols[idx1].merged(vols[idx2]);
             // if (merge.rad + 0.0001 < bound.rad)
             // std::cout << "!!!!!!!!!!!!!!!!!!!!!!!!!!!!!" << std::endl;
-            // vols.push_back(bound.rad < merge.rad ? bound : merge);
-            child.push_back(idx1);
-            child.push_back(idx2);
+            // vols[node] = bound.rad < merge.rad ? bound : merge;
+            child[2 * node] = idx1;
+            child[2 * node + 1] = idx2;
+        }
+    }
+
+    // bounds the object centers of a subtree with children bounded by vol1
+    // and vol2. lb/ub always span the subtree's object positions, as welzl's
+    template <typename SubtreeObjs>
+    Volume bound_subtree(SubtreeObjs subtree_objs, Volume const &vol1,
+                         Volume const &vol2) const {
+        if (bound_method == BoundMethod::merge) {
+            Volume bound = vol1.merged(vol2);
+            UpdateBounds<SubtreeObjs, Volume, true>::update_bounds(
+                subtree_objs, bound);
+            return bound;
+        }
+        if (bound_method == BoundMethod::ritter)
+            return ritter_bounding_ball<Volume, true>(subtree_objs);
+        // central is 3D only, other trees use BoundingSphere
+        if constexpr (DIM == 3 && std::is_same<Volume, Sphere<F>>::value) {
+            if (bound_method == BoundMethod::central)
+                return central_bounding_sphere<true>(subtree_objs);
+        }
+        return BoundingSphere::bound(subtree_objs);
+    }
+
+    // the bound above covers object centers only, grow it to cover objects
+    // with extent (spheres, capsules) too. points have rad 0 and are skipped
+    static void fit_extents(Volume &bound, VIPairs const &ocen, int from,
+                            int to, Vols const &ovol) {
+        for (int i = from; i < to; ++i) {
+            Volume const &v = ovol[ocen[i].second];
+            if (v.rad > 0)
+                bound.rad =
+                    std::max(bound.rad, (v.cen - bound.cen).norm() + v.rad);
+        }
+    }
+};
+
+/** A SphereBVH that builds only its top levels up front. Below that, nodes
+ * are object ranges with a bounding sphere, split the first time getChildren
+ * reaches them, so a few queries against a very large object set only pay for
+ * the part of the tree they touch. Expansion is thread safe and the nodes
+ * built by one query are reused by all later ones. Has the same traversal
+ * interface as SphereBVH, so works with BVIntersect / BVMinimize and the
+ * existing intersectors / minimizers. Nodes are numbered from the root down,
+ * not children first as in SphereBVH.
+ */
+template <typename _Scalar, typename _Object, int _DIM = 3,
+          typename _Volume = Sphere<_Scalar>,
+          typename BoundingSphere = WelzlBoundingSphere<_Scalar, true>>
+class LazySphereBVH {
+  public:
+    static int const DIM = _DIM;
+    typedef _Object Object;
+    typedef std::vector<Object, Eigen::aligned_allocator<Object>> Objs;
+    typedef _Scalar F;
+    typedef _Volume Volume;
+    typedef std::vector<Volume, Eigen::aligned_allocator<Volume>> Vols;
+    typedef int Index;
+    typedef const int *VolumeIterator;
+    typedef const Object *ObjectIterator;
+
+    // room for all n-1 nodes is allocated up front so nothing moves while
+    // other threads read; only the first nbuilt() vols hold real nodes
+    std::vector<int> child;
+    Vols vols;
+    Objs objs;
+
+    LazySphereBVH() {}
+
+    template <typename Iter>
+    LazySphereBVH(Iter begin, Iter end, int levels = 8) {
+        init(begin, end, levels);
+    }
+
+    size_t size() const { return objs.size(); }
+
+    /** number of nodes built so far, the full tree has size()-1 */
+    int nbuilt() const { return nnode.load(); }
+
+    /** number of nodes split so far */
+    int nexpanded() const { return nexpand.load(); }
+
+    /** builds the top \a levels levels of nodes over the objects, so
+        2^levels - 1 nodes for a big enough tree. the root is always built */
+    template <typename Iter> void init(Iter begin, Iter end, int levels) {
+        objs.assign(begin, end);
+        int n = static_cast<int>(objs.size());
+        int nvol = std::max(0, n - 1);
+        child.assign(2 * nvol, -1);
+        vols.assign(nvol, Volume());
+        lo.assign(nvol, 0);
+        hi.assign(nvol, 0);
+        built.reset(new std::atomic<char>[nvol]);
+        for (int i = 0; i < nvol; ++i) built[i] = 0;
+        nnode = 0;
+        nexpand = 0;
+        if (n < 2) return;
+        expand_levels(make_node(0, n), levels - 1);
+    }
+
+    /** builds whatever is not built yet */
+    void expand_all() {
+        if (!vols.empty()) expand_levels(getRootIndex(), 1 << 30);
+    }
+
+    inline Index getRootIndex() const { return vols.empty() ? -1 : 0; }
+
+    /** as SphereBVH::getChildren, first splitting \a index if needed */
+    EIGEN_STRONG_INLINE
+    void getChildren(Index index, VolumeIterator &vbeg, VolumeIterator &vend,
+                     ObjectIterator &obeg, ObjectIterator &oend) const {
+        if (index < 0) {
+            vbeg = vend;
+            if (!objs.empty()) obeg = &(objs[0]);
+            oend = obeg + objs.size();
+            return;
+        }
+        if (!built[index].load(std::memory_order_acquire))
+            const_cast<LazySphereBVH *>(this)->expand(index);
+
+        int nvol = static_cast<int>(vols.size());
+        int idx = index * 2;
+        if (child[idx + 1] < nvol) {
+            vbeg = &(child[idx]);
+            vend = vbeg + 2;
+            obeg = oend;
+        } else if (child[idx] >= nvol) {
+            vbeg = vend;
+            obeg = &(objs[child[idx] - nvol]);
+            oend = obeg + 2;
+        } else {
+            vbeg = &(child[idx]);
+            vend = vbeg + 1;
+            obeg = &(objs[child[idx + 1] - nvol]);
+            oend = obeg + 1;
+        }
+    }
+
+    inline const Volume &getVolume(Index index) const { return vols[index]; }
+
+    /** splits node \a index into its two children, if not already done */
+    void expand(Index index) {
+        std::lock_guard<std::mutex> lock(locks[index % NLOCK]);
+        if (built[index].load(std::memory_order_relaxed)) return;
+        int from = lo[index], to = hi[index];
+        int mid = from + (to - from + 1) / 2; // bigger half first
+        if (to - from > 2) {
+            auto sep = most_separated_points_on_AABB(CenRange{&objs[from],
+                                                     (size_t)(to - from)});
+            auto normal = (sep.second - sep.first).eval();
+            std::nth_element(objs.begin() + from, objs.begin() + mid,
+                             objs.begin() + to, DotComparator(normal));
+        }
+        int nvol = static_cast<int>(vols.size());
+        child[2 * index] = mid - from > 1 ? make_node(from, mid) : nvol + from;
+        child[2 * index + 1] = to - mid > 1 ? make_node(mid, to) : nvol + mid;
+        ++nexpand;
+        built[index].store(1, std::memory_order_release);
+    }
+
+  private:
+    static int const NLOCK = 64;
+    std::vector<int> lo, hi; // object range of each node
+    std::unique_ptr<std::atomic<char>[]> built;
+    std::mutex locks[NLOCK];
+    std::atomic<int> nnode{0}, nexpand{0};
+
+    // object centers in a range, as the bounding sphere routines want them
+    struct CenRange {
+        using value_type = Eigen::Matrix<F, DIM, 1>;
+        Object const *a;
+        size_t n;
+        value_type operator[](size_t i) const { return bounding_vol(a[i]).cen; }
+        size_t size() const { return n; }
+        int get_index(size_t i) const { return bounding_vol(a[i]).lb; }
+    };
+    struct DotComparator {
+        Eigen::Matrix<F, DIM, 1> normal;
+        DotComparator(const Eigen::Matrix<F, DIM, 1> &n) : normal(n) {}
+        inline bool operator()(const Object &a, const Object &b) const {
+            return bounding_vol(a).cen.dot(normal) <
+                   bounding_vol(b).cen.dot(normal);
+        }
+    };
+
+    int make_node(int from, int to) {
+        int i = nnode++;
+        lo[i] = from;
+        hi[i] = to;
+        if (to - from == 2)
+            vols[i] = bounding_vol(objs[from]).merged(
+                bounding_vol(objs[from + 1]));
+        else {
+            vols[i] = BoundingSphere::bound(
+                CenRange{&objs[from], (size_t)(to - from)});
+            // cover objects with extent, as SphereBVH::fit_extents
+            for (int k = from; k < to; ++k) {
+                Volume v = bounding_vol(objs[k]);
+                if (v.rad > 0)
+                    vols[i].rad = std::max(
+                        vols[i].rad, (v.cen - vols[i].cen).norm() + v.rad);
+            }
+        }
+        return i;
+    }
+
+    void expand_levels(Index index, int levels) {
+        if (levels <= 0) return;
+        expand(index);
+        int nvol = static_cast<int>(vols.size());
+        for (int k = 0; k < 2; ++k)
+            if (child[2 * index + k] < nvol)
+                expand_levels(child[2 * index + k], levels - 1);
+    }
+};
+
+/** A sphere tree that supports inserting and removing objects without a
+ * rebuild. Each leaf node holds one object. Insertion picks the sibling with
+ * the least total growth in rad^2 by Box2D's branch and bound search, and the
+ * path back to the root is refit and rotated, AVL style where the heights of
+ * two children differ by more than one and otherwise where swapping a child
+ * and a grandchild shrinks a node, as in Box2D's dynamic tree. Objects are
+ * removed by id, the id being bounding_vol(obj).lb, and the objs vector stays
+ * dense. Has the same traversal interface as SphereBVH so works with
+ * BVIntersect / BVMinimize and the existing queries. Volume lb/ub are the id
+ * range below each node. Not safe to modify during a query.
+ */
+template <typename _Scalar, typename _Object, int _DIM = 3,
+          typename _Volume = Sphere<_Scalar>>
+class DynamicSphereBVH {
+  public:
+    static int const DIM = _DIM;
+    typedef _Object Object;
+    typedef std::vector<Object, Eigen::aligned_allocator<Object>> Objs;
+    typedef _Scalar F;
+    typedef _Volume Volume;
+    typedef std::vector<Volume, Eigen::aligned_allocator<Volume>> Vols;
+    typedef int Index;
+    typedef const int *VolumeIterator;
+    typedef const Object *ObjectIterator;
+
+    struct Node {
+        int child[2] = {-1, -1};
+        int parent = -1;
+        int obj = -1; // object index for leaves, -1 otherwise
+        int height = 0;
+    };
+
+    Vols vols; // indexed like nodes, unused for free nodes
+    Objs objs;
+    std::vector<Node> nodes;
+
+    DynamicSphereBVH() {}
+
+    template <typename Iter> DynamicSphereBVH(Iter begin, Iter end) {
+        for (; begin != end; ++begin) insert(*begin);
+    }
+
+    size_t size() const { return objs.size(); }
+
+    /** height of the tree, 0 for a single leaf, -1 when empty */
+    int height() const { return root < 0 ? -1 : nodes[root].height; }
+
+    /** adds \a obj, returns its current index in objs */
+    int insert(Object const &obj) {
+        int slot = (int)objs.size();
+        objs.push_back(obj);
+        int leaf = alloc_node();
+        nodes[leaf].obj = slot;
+        vols[leaf] = bounding_vol(obj);
+        leafof.push_back(leaf);
+        byid[vols[leaf].lb].push_back(slot);
+        insert_leaf(leaf);
+        return slot;
+    }
+
+    /** removes all objects with id \a id, returns how many */
+    int remove(int id) {
+        auto it = byid.find(id);
+        if (it == byid.end()) return 0;
+        std::vector<int> slots = it->second;
+        byid.erase(it);
+        // highest first, so the object moved into a freed slot is never one
+        // still waiting to be removed
+        std::sort(slots.rbegin(), slots.rend());
+        for (int slot : slots) remove_slot(slot);
+        return (int)slots.size();
+    }
+
+    inline Index getRootIndex() const { return root; }
+
+    EIGEN_STRONG_INLINE
+    void getChildren(Index index, VolumeIterator &vbeg, VolumeIterator &vend,
+                     ObjectIterator &obeg, ObjectIterator &oend) const {
+        if (index < 0) {
+            vbeg = vend;
+            if (!objs.empty()) obeg = &(objs[0]);
+            oend = obeg + objs.size();
+            return;
+        }
+        Node const &n = nodes[index];
+        if (n.obj < 0) {
+            vbeg = &(n.child[0]);
+            vend = vbeg + 2;
+            obeg = oend;
+        } else {
+            vbeg = vend;
+            obeg = &(objs[n.obj]);
+            oend = obeg + 1;
+        }
+    }
+
+    inline const Volume &getVolume(Index index) const { return vols[index]; }
+
+    /** checks parent links, heights and that every node bounds its
+     * children, for testing. balance is kept by the rotations but not to a
+     * strict AVL bound, a new leaf may be paired with a taller subtree */
+    bool check() const {
+        if (root < 0) return objs.empty();
+        if (nodes[root].parent != -1) return false;
+        int nleaf = 0;
+        for (int i = 0; i < (int)nodes.size(); ++i) {
+            Node const &n = nodes[i];
+            if (n.height < 0) continue; // free
+            if (n.obj >= 0) {
+                ++nleaf;
+                if (leafof[n.obj] != i || n.height != 0) return false;
+                continue;
+            }
+            Node const &a = nodes[n.child[0]], &b = nodes[n.child[1]];
+            if (a.parent != i || b.parent != i) return false;
+            if (n.height != 1 + std::max(a.height, b.height)) return false;
+            for (int c : n.child) {
+                Volume const &v = vols[c];
+                if ((v.cen - vols[i].cen).norm() + v.rad >
+                    vols[i].rad * (1 + 1e-4) + 1e-4)
+                    return false;
+                if (v.lb < vols[i].lb || v.ub > vols[i].ub) return false;
+            }
+        }
+        return nleaf == (int)objs.size();
+    }
+
+    /** as SphereBVH::quality */
+    BVHQuality quality() const {
+        BVHQuality q;
+        q.nvol = (int)objs.size() - 1;
+        if (objs.size() < 2) return q;
+        std::vector<std::pair<int, int>> stack{{root, 0}};
+        while (!stack.empty()) {
+            auto [index, depth] = stack.back();
+            stack.pop_back();
+            Node const &n = nodes[index];
+            if (n.obj >= 0) {
+                q.maxdepth = std::max(q.maxdepth, depth);
+                q.meandepth += depth;
+                continue;
+            }
+            q.sumrad += vols[index].rad;
+            Volume const &a = vols[n.child[0]], &b = vols[n.child[1]];
+            q.overlap += std::max<double>(
+                0, a.rad + b.rad - (a.cen - b.cen).norm());
+            for (int c : n.child) stack.emplace_back(c, depth + 1);
+        }
+        q.meandepth /= objs.size();
+        return q;
+    }
+
+  private:
+    int root = -1;
+    std::vector<int> freenodes;
+    std::vector<int> leafof; // leaf node of each object
+    std::unordered_map<int, std::vector<int>> byid;
+
+    static Volume merge(Volume const &a, Volume const &b) {
+        Volume v = a.merged(b); // keeps only one side's lb/ub if one contains
+        v.lb = std::min(a.lb, b.lb);
+        v.ub = std::max(a.ub, b.ub);
+        return v;
+    }
+
+    int alloc_node() {
+        if (freenodes.empty()) {
+            nodes.emplace_back();
+            vols.emplace_back();
+            return (int)nodes.size() - 1;
+        }
+        int i = freenodes.back();
+        freenodes.pop_back();
+        nodes[i] = Node();
+        return i;
+    }
+    void free_node(int i) {
+        nodes[i].height = -1;
+        freenodes.push_back(i);
+    }
+
+    void refit(int i) {
+        Node &n = nodes[i];
+        n.height = 1 + std::max(nodes[n.child[0]].height,
+                                nodes[n.child[1]].height);
+        vols[i] = merge(vols[n.child[0]], vols[n.child[1]]);
+    }
+
+    // refit and rebalance from i up to the root
+    void fix_upwards(int i) {
+        while (i >= 0) {
+            int j = balance(i);
+            refit(j);
+            if (j == i) rotate_area(i);
+            i = nodes[j].parent;
         }
     }
+
+    void insert_leaf(int leaf) {
+        if (root < 0) {
+            root = leaf;
+            nodes[leaf].parent = -1;
+            return;
+        }
+        int sibling = best_sibling(vols[leaf]);
+        int oldparent = nodes[sibling].parent;
+        int newparent = alloc_node();
+        nodes[newparent].parent = oldparent;
+        nodes[newparent].child[0] = sibling;
+        nodes[newparent].child[1] = leaf;
+        nodes[sibling].parent = newparent;
+        nodes[leaf].parent = newparent;
+        if (oldparent < 0)
+            root = newparent;
+        else
+            nodes[oldparent].child[nodes[oldparent].child[1] == sibling] =
+                newparent;
+        fix_upwards(newparent);
+    }
+
+    void remove_leaf(int leaf) {
+        if (leaf == root) {
+            root = -1;
+            return;
+        }
+        int parent = nodes[leaf].parent;
+        int grand = nodes[parent].parent;
+        int sibling = nodes[parent].child[nodes[parent].child[0] == leaf];
+        nodes[sibling].parent = grand;
+        if (grand < 0) {
+            root = sibling;
+        } else {
+            nodes[grand].child[nodes[grand].child[1] == parent] = sibling;
+            fix_upwards(grand);
+        }
+        free_node(parent);
+    }
+
+    void remove_slot(int slot) {
+        int leaf = leafof[slot];
+        remove_leaf(leaf);
+        free_node(leaf);
+        int last = (int)objs.size() - 1;
+        if (slot != last) {
+            objs[slot] = objs[last];
+            leafof[slot] = leafof[last];
+            nodes[leafof[slot]].obj = slot;
+            for (int &s : byid[vols[leafof[slot]].lb])
+                if (s == last) s = slot;
+        }
+        objs.pop_back();
+        leafof.pop_back();
+    }
+
+    static F area(Volume const &v) { return v.rad * v.rad; }
+
+    // Box2D's branch and bound search for the sibling of a new leaf, with
+    // rad^2 as the area of a node. pairing with a node costs a new parent of
+    // the combined area plus the growth of each of its ancestors
+    int best_sibling(Volume const &lv) const {
+        int best = root;
+        F bestcost = area(merge(vols[root], lv));
+        std::vector<std::pair<int, F>> stack{{root, F(0)}};
+        while (!stack.empty()) {
+            auto [index, inherit] = stack.back();
+            stack.pop_back();
+            F direct = area(merge(vols[index], lv));
+            if (direct + inherit < bestcost) {
+                bestcost = direct + inherit;
+                best = index;
+            }
+            if (nodes[index].obj >= 0) continue;
+            inherit += direct - area(vols[index]);
+            if (area(lv) + inherit < bestcost)
+                for (int c : nodes[index].child) stack.emplace_back(c, inherit);
+        }
+        return best;
+    }
+
+    // swaps a child of ia with a grandchild under its other child when
+    // that shrinks the other child, as in Kopta et al. and Box2D v3
+    void rotate_area(int ia) {
+        Node const &a = nodes[ia];
+        if (a.obj >= 0) return;
+        F bestgain = 0;
+        int bx = -1, bg = -1;
+        for (int k = 0; k < 2; ++k) {
+            int x = a.child[k], ip = a.child[1 - k];
+            if (nodes[ip].obj >= 0) continue;
+            for (int j = 0; j < 2; ++j) {
+                int g = nodes[ip].child[j], keep = nodes[ip].child[1 - j];
+                F gain = area(vols[ip]) - area(merge(vols[x], vols[keep]));
+                if (gain > bestgain) {
+                    bestgain = gain;
+                    bx = x;
+                    bg = g;
+                }
+            }
+        }
+        if (bx < 0) return;
+        int ip = nodes[bg].parent;
+        nodes[ia].child[nodes[ia].child[1] == bx] = bg;
+        nodes[ip].child[nodes[ip].child[1] == bg] = bx;
+        nodes[bg].parent = ia;
+        nodes[bx].parent = ip;
+        refit(ip);
+        refit(ia);
+    }
+
+    // rotates the taller grandchild up if i is out of balance, returns the
+    // index now at i's place
+    int balance(int ia) {
+        Node &a = nodes[ia];
+        if (a.obj >= 0 || a.height < 2) return ia;
+        int ib = a.child[0], ic = a.child[1];
+        int diff = nodes[ic].height - nodes[ib].height;
+        if (diff > 1) return rotate(ia, 1);
+        if (diff < -1) return rotate(ia, 0);
+        return ia;
+    }
+    // lifts child k of ia above it
+    int rotate(int ia, int k) {
+        int ic = nodes[ia].child[k];
+        int i_f = nodes[ic].child[0], ig = nodes[ic].child[1];
+        int up = nodes[ia].parent;
+        nodes[ic].child[0] = ia;
+        nodes[ic].parent = up;
+        nodes[ia].parent = ic;
+        if (up < 0)
+            root = ic;
+        else
+            nodes[up].child[nodes[up].child[1] == ia] = ic;
+        // the taller of c's children stays under c, the other goes to a
+        if (nodes[i_f].height < nodes[ig].height) std::swap(i_f, ig);
+        nodes[ic].child[1] = i_f;
+        nodes[ia].child[k] = ig;
+        nodes[ig].parent = ia;
+        refit(ia);
+        refit(ic);
+        return ic;
+    }
 };
 } // namespace bvh
 } // namespace hgeom
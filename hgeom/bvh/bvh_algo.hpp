@@ -3,6 +3,10 @@
 #pragma once
 /** \file */
 
+#include <array>
+#include <tuple>
+#include <utility>
+
 namespace hgeom {
 namespace bvh {
 
@@ -173,6 +177,70 @@ void BVIntersect(
   }
 }
 
+////////////////////////////////////////////////////////////////////////
+/////////////////////// Composite Intersector //////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+/**  Runs several two-tree intersectors in a single BVIntersect traversal.
+  *  A node pair is descended if any still-active query wants it, and object
+  *  pairs are handed to every still-active query. A query whose
+  *  intersectObjectObject returns true (asking to stop) is marked done and
+  *  sees no further pairs; the traversal stops once all queries are done.
+  *  Queries are held by reference, read results from the originals.
+  */
+template <typename... Queries> struct CompositeIntersector {
+  static constexpr size_t N = sizeof...(Queries);
+  std::tuple<Queries &...> queries;
+  std::array<bool, N> done{};
+  size_t ndone = 0;
+
+  CompositeIntersector(Queries &...q) : queries(q...) {}
+
+  template <typename V1, typename V2>
+  bool intersectVolumeVolume(const V1 &v1, const V2 &v2) {
+    return any([&](auto &q) { return q.intersectVolumeVolume(v1, v2); });
+  }
+  template <typename V1, typename O2>
+  bool intersectVolumeObject(const V1 &v1, const O2 &o2) {
+    return any([&](auto &q) { return q.intersectVolumeObject(v1, o2); });
+  }
+  template <typename O1, typename V2>
+  bool intersectObjectVolume(const O1 &o1, const V2 &v2) {
+    return any([&](auto &q) { return q.intersectObjectVolume(o1, v2); });
+  }
+  template <typename O1, typename O2>
+  bool intersectObjectObject(const O1 &o1, const O2 &o2) {
+    each([&](auto &q, bool &qdone) {
+      if (q.intersectObjectObject(o1, o2)) {
+        qdone = true;
+        ++ndone;
+      }
+    });
+    return ndone == N;
+  }
+
+private:
+  template <typename Func> bool any(Func &&f) {
+    return any_impl(f, std::index_sequence_for<Queries...>());
+  }
+  template <typename Func, size_t... I>
+  bool any_impl(Func &f, std::index_sequence<I...>) {
+    return ((!done[I] && f(std::get<I>(queries))) || ...);
+  }
+  template <typename Func> void each(Func &&f) {
+    each_impl(f, std::index_sequence_for<Queries...>());
+  }
+  template <typename Func, size_t... I>
+  void each_impl(Func &f, std::index_sequence<I...>) {
+    ((done[I] ? void() : f(std::get<I>(queries), done[I])), ...);
+  }
+};
+
+template <typename... Queries>
+CompositeIntersector<Queries...> make_composite_intersector(Queries &...q) {
+  return CompositeIntersector<Queries...>(q...);
+}
+
 ////////////////////////////////////////////////////////////////////////
 ///////////////////////////// Minimizer ////////////////////////////////
 ////////////////////////////////////////////////////////////////////////
@@ -183,7 +251,8 @@ namespace internal {
 template <typename BVH, typename Minimizer>
 typename Minimizer::Scalar
 minimize_helper(const BVH &tree, Minimizer &minimizer, typename BVH::Index root,
-                typename Minimizer::Scalar minimum) {
+                typename Minimizer::Scalar minimum,
+                typename Minimizer::Scalar eps = 0) {
   typedef typename Minimizer::Scalar Scalar;
   typedef typename BVH::Index Index;
   typedef std::pair<Scalar, Index> QueueElement; // first element is priority
@@ -196,9 +265,12 @@ minimize_helper(const BVH &tree, Minimizer &minimizer, typename BVH::Index root,
                       std::greater<QueueElement>>
       todo; // smallest is at the top
 
-  todo.push(std::make_pair(Scalar(), root));
+  todo.push(std::make_pair(std::numeric_limits<Scalar>::lowest(), root));
 
   while (!todo.empty()) {
+    // everything left is bounded below by the top, no closer than minimum-eps
+    if (todo.top().first >= minimum - eps)
+      break;
     tree.getChildren(todo.top().second, vBegin, vEnd, oBegin, oEnd);
     todo.pop();
 
@@ -208,7 +280,7 @@ minimize_helper(const BVH &tree, Minimizer &minimizer, typename BVH::Index root,
 
     for (; vBegin != vEnd; ++vBegin) { // go through child volumes
       Scalar val = minimizer.minimumOnVolume(tree.getVolume(*vBegin));
-      if (val < minimum)
+      if (val < minimum - eps)
         todo.push(std::make_pair(val, *vBegin));
     }
   }
@@ -265,12 +337,16 @@ private:
      Scalar minimumOnVolume(const BVH::Volume &volume)
      Scalar minimumOnObject(const BVH::Object &object)
   \endcode
+  *  With \a eps > 0 any node whose lower bound is within eps of the current
+  *  best is skipped, so the result is at most eps above the true minimum.
   */
 template <typename BVH, typename Minimizer>
-typename Minimizer::Scalar BVMinimize(const BVH &tree, Minimizer &minimizer) {
+typename Minimizer::Scalar
+BVMinimize(const BVH &tree, Minimizer &minimizer,
+           typename Minimizer::Scalar eps = 0) {
   return internal::minimize_helper(
       tree, minimizer, tree.getRootIndex(),
-      std::numeric_limits<typename Minimizer::Scalar>::max());
+      std::numeric_limits<typename Minimizer::Scalar>::max(), eps);
 }
 
 /**  Given two BVH's, runs the query on their cartesian product encapsulated by
@@ -288,10 +364,13 @@ typename Minimizer::Scalar BVMinimize(const BVH &tree, Minimizer &minimizer) {
      Scalar minimumOnObjectObject(const BVH1::Object &o1, const BVH2::Object
   &o2)
   \endcode
+  *  With \a eps > 0 the result is at most eps above the true minimum, see
+  *  the single tree BVMinimize.
   */
 template <typename BVH1, typename BVH2, typename Minimizer>
 typename Minimizer::Scalar BVMinimize(const BVH1 &tree1, const BVH2 &tree2,
-                                      Minimizer &minimizer) {
+                                      Minimizer &minimizer,
+                                      typename Minimizer::Scalar eps = 0) {
   typedef typename Minimizer::Scalar Scalar;
   typedef typename BVH1::Index Index1;
   typedef typename BVH2::Index Index2;
@@ -320,9 +399,12 @@ typename Minimizer::Scalar BVMinimize(const BVH1 &tree1, const BVH2 &tree2,
 
   Scalar minimum = (std::numeric_limits<Scalar>::max)();
   todo.push(std::make_pair(
-      Scalar(), std::make_pair(tree1.getRootIndex(), tree2.getRootIndex())));
+      std::numeric_limits<Scalar>::lowest(),
+      std::make_pair(tree1.getRootIndex(), tree2.getRootIndex())));
 
   while (!todo.empty()) {
+    if (todo.top().first >= minimum - eps)
+      break;
     tree1.getChildren(todo.top().second.first, vBegin1, vEnd1, oBegin1, oEnd1);
     tree2.getChildren(todo.top().second.second, vBegin2, vEnd2, oBegin2, oEnd2);
     todo.pop();
@@ -338,8 +420,8 @@ typename Minimizer::Scalar BVMinimize(const BVH1 &tree1, const BVH2 &tree2,
       for (vCur2 = vBegin2; vCur2 != vEnd2;
            ++vCur2) { // go through child volumes of second tree
         Helper2 helper(*oBegin1, minimizer);
-        minimum = (std::min)(
-            minimum, internal::minimize_helper(tree2, helper, *vCur2, minimum));
+        minimum = (std::min)(minimum, internal::minimize_helper(
+                                          tree2, helper, *vCur2, minimum, eps));
       }
     }
 
@@ -351,14 +433,14 @@ typename Minimizer::Scalar BVMinimize(const BVH1 &tree1, const BVH2 &tree2,
            ++oCur2) { // go through child objects of second tree
         Helper1 helper(*oCur2, minimizer);
         minimum = (std::min)(minimum, internal::minimize_helper(
-                                          tree1, helper, *vBegin1, minimum));
+                                          tree1, helper, *vBegin1, minimum, eps));
       }
 
       for (vCur2 = vBegin2; vCur2 != vEnd2;
            ++vCur2) { // go through child volumes of second tree
         Scalar val =
             minimizer.minimumOnVolumeVolume(vol1, tree2.getVolume(*vCur2));
-        if (val < minimum)
+        if (val < minimum - eps)
           todo.push(std::make_pair(val, std::make_pair(*vBegin1, *vCur2)));
       }
     }
@@ -366,6 +448,208 @@ typename Minimizer::Scalar BVMinimize(const BVH1 &tree1, const BVH2 &tree2,
   return minimum;
 }
 
+////////////////////////////////////////////////////////////////////////
+/////////////////////// All Nearest Neighbors //////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+namespace internal {
+
+#ifndef EIGEN_PARSED_BY_DOXYGEN
+template <typename BVH1, typename BVH2, typename Minimizer>
+struct all_nearest_helper {
+  typedef typename Minimizer::Scalar Scalar;
+  typedef typename BVH1::Index Index1;
+  typedef typename BVH2::Index Index2;
+  typedef typename BVH1::VolumeIterator VolIter1;
+  typedef typename BVH1::ObjectIterator ObjIter1;
+  typedef typename BVH2::VolumeIterator VolIter2;
+  typedef typename BVH2::ObjectIterator ObjIter2;
+
+  const BVH1 &tree1;
+  const BVH2 &tree2;
+  Minimizer &minimizer;
+  Scalar *best;  // per tree1 object
+  int *partner;  // per tree1 object, a tree2 object index
+  Scalar *bound; // per tree1 volume, the max of best[] below it
+
+  all_nearest_helper(const BVH1 &t1, const BVH2 &t2, Minimizer &m, Scalar *b,
+                     int *p, Scalar *bnd)
+      : tree1(t1), tree2(t2), minimizer(m), best(b), partner(p), bound(bnd) {}
+
+  // object iterators point into the objs vectors
+  int index1(ObjIter1 o) const { return (int)(o - tree1.objs.data()); }
+  int index2(ObjIter2 o) const { return (int)(o - tree2.objs.data()); }
+
+  void update(ObjIter1 o1, ObjIter2 o2) {
+    int i = index1(o1);
+    Scalar d = minimizer.minimumOnObjectObject(*o1, *o2);
+    if (d < best[i]) {
+      best[i] = d;
+      partner[i] = index2(o2);
+    }
+  }
+
+  void refresh(Index1 v1) {
+    VolIter1 vBegin = VolIter1(), vEnd = VolIter1();
+    ObjIter1 oBegin = ObjIter1(), oEnd = ObjIter1();
+    tree1.getChildren(v1, vBegin, vEnd, oBegin, oEnd);
+    Scalar b = std::numeric_limits<Scalar>::lowest();
+    for (; vBegin != vEnd; ++vBegin) b = (std::max)(b, bound[*vBegin]);
+    for (; oBegin != oEnd; ++oBegin) b = (std::max)(b, best[index1(oBegin)]);
+    bound[v1] = b;
+  }
+
+  // one tree1 object against the tree2 subtree at v2, closer child first
+  void object_volume(ObjIter1 o1, Index2 v2) {
+    VolIter2 vBegin = VolIter2(), vEnd = VolIter2();
+    ObjIter2 oBegin = ObjIter2(), oEnd = ObjIter2();
+    tree2.getChildren(v2, vBegin, vEnd, oBegin, oEnd);
+    for (; oBegin != oEnd; ++oBegin) update(o1, oBegin);
+    Scalar &b = best[index1(o1)];
+    if (vEnd - vBegin == 2) {
+      Scalar d0 =
+          minimizer.minimumOnObjectVolume(*o1, tree2.getVolume(vBegin[0]));
+      Scalar d1 =
+          minimizer.minimumOnObjectVolume(*o1, tree2.getVolume(vBegin[1]));
+      int first = d1 < d0 ? 1 : 0;
+      if ((first ? d1 : d0) < b) object_volume(o1, vBegin[first]);
+      if ((first ? d0 : d1) < b) object_volume(o1, vBegin[1 - first]);
+      return;
+    }
+    for (; vBegin != vEnd; ++vBegin)
+      if (minimizer.minimumOnObjectVolume(*o1, tree2.getVolume(*vBegin)) < b)
+        object_volume(o1, *vBegin);
+  }
+
+  // one tree2 object against every tree1 object below v1
+  void volume_object(Index1 v1, ObjIter2 o2) {
+    if (minimizer.minimumOnVolumeObject(tree1.getVolume(v1), *o2) >= bound[v1])
+      return;
+    VolIter1 vBegin = VolIter1(), vEnd = VolIter1();
+    ObjIter1 oBegin = ObjIter1(), oEnd = ObjIter1();
+    tree1.getChildren(v1, vBegin, vEnd, oBegin, oEnd);
+    for (; oBegin != oEnd; ++oBegin) update(oBegin, o2);
+    for (; vBegin != vEnd; ++vBegin) volume_object(*vBegin, o2);
+    refresh(v1);
+  }
+
+  // a node pair is pruned for the whole tree1 subtree once it is no closer
+  // than the worst best[] below v1, d is their minimumOnVolumeVolume. the
+  // bound is only tight for small nodes, so tree1 is split until its node is
+  // under a quarter the size of the tree2 node. the objects of a split tree1
+  // node are each pruned on their own best[]
+  void volume_volume(Index1 v1, Index2 v2, Scalar d) {
+    if (d >= bound[v1]) return;
+    auto const &vol1 = tree1.getVolume(v1);
+    auto const &vol2 = tree2.getVolume(v2);
+    if (4 * vol1.rad >= vol2.rad) {
+      VolIter1 vBegin = VolIter1(), vEnd = VolIter1();
+      ObjIter1 oBegin = ObjIter1(), oEnd = ObjIter1();
+      tree1.getChildren(v1, vBegin, vEnd, oBegin, oEnd);
+      for (; oBegin != oEnd; ++oBegin)
+        if (minimizer.minimumOnObjectVolume(*oBegin, vol2) <
+            best[index1(oBegin)])
+          object_volume(oBegin, v2);
+      for (; vBegin != vEnd; ++vBegin)
+        volume_volume(*vBegin, v2,
+                      minimizer.minimumOnVolumeVolume(
+                          tree1.getVolume(*vBegin), vol2));
+    } else {
+      VolIter2 vBegin = VolIter2(), vEnd = VolIter2();
+      ObjIter2 oBegin = ObjIter2(), oEnd = ObjIter2();
+      tree2.getChildren(v2, vBegin, vEnd, oBegin, oEnd);
+      for (; oBegin != oEnd; ++oBegin) volume_object(v1, oBegin);
+      if (vEnd - vBegin == 2) {
+        Scalar d0 =
+            minimizer.minimumOnVolumeVolume(vol1, tree2.getVolume(vBegin[0]));
+        Scalar d1 =
+            minimizer.minimumOnVolumeVolume(vol1, tree2.getVolume(vBegin[1]));
+        int first = d1 < d0 ? 1 : 0;
+        volume_volume(v1, vBegin[first], first ? d1 : d0);
+        volume_volume(v1, vBegin[1 - first], first ? d0 : d1);
+      } else {
+        for (; vBegin != vEnd; ++vBegin)
+          volume_volume(v1, *vBegin,
+                        minimizer.minimumOnVolumeVolume(
+                            vol1, tree2.getVolume(*vBegin)));
+      }
+    }
+    refresh(v1);
+  }
+
+  // a tree with fewer than two objects has no volumes, its negative root
+  // lists all its objects
+  void run(Index1 root1) {
+    Index2 root2 = tree2.getRootIndex();
+    if (root1 >= 0 && root2 >= 0)
+      return volume_volume(root1, root2, std::numeric_limits<Scalar>::lowest());
+    VolIter1 vBegin1 = VolIter1(), vEnd1 = VolIter1();
+    ObjIter1 oBegin1 = ObjIter1(), oEnd1 = ObjIter1();
+    VolIter2 vBegin2 = VolIter2(), vEnd2 = VolIter2();
+    ObjIter2 oBegin2 = ObjIter2(), oEnd2 = ObjIter2();
+    if (root1 < 0) {
+      tree1.getChildren(root1, vBegin1, vEnd1, oBegin1, oEnd1);
+      for (; oBegin1 != oEnd1; ++oBegin1) object_volume(oBegin1, root2);
+    } else {
+      tree2.getChildren(root2, vBegin2, vEnd2, oBegin2, oEnd2);
+      for (; oBegin2 != oEnd2; ++oBegin2) volume_object(root1, oBegin2);
+    }
+  }
+};
+#endif // not EIGEN_PARSED_BY_DOXYGEN
+
+} // namespace internal
+
+/**  Given two BVH's, finds for every object below \a root1 of \a tree1 its
+  nearest object in \a tree2, by a dual-tree traversal of the cartesian
+  product encapsulated by \a minimizer.
+  *  best and partner are indexed like tree1.objs and must be set to the
+  largest Scalar and -1 on entry. on exit partner holds tree2.objs indices.
+  bound is indexed like tree1.vols, it needs no setup. disjoint subtrees of
+  tree1 may be run concurrently on the same arrays, each with its own
+  minimizer.
+  *  The Minimizer must provide the same members as for two-tree BVMinimize,
+  and both BVH types must expose their objs vectors.
+  */
+template <typename BVH1, typename BVH2, typename Minimizer>
+void BVAllNearest(const BVH1 &tree1, const BVH2 &tree2, Minimizer &minimizer,
+                  typename Minimizer::Scalar *best, int *partner,
+                  typename Minimizer::Scalar *bound,
+                  typename BVH1::Index root1) {
+  typedef typename Minimizer::Scalar Scalar;
+  typedef typename BVH1::Index Index1;
+  typedef typename BVH1::VolumeIterator VolIter1;
+  typedef typename BVH1::ObjectIterator ObjIter1;
+  VolIter1 vBegin = VolIter1(), vEnd = VolIter1();
+  ObjIter1 oBegin = ObjIter1(), oEnd = ObjIter1();
+  if (root1 >= 0) { // bound[] of every volume below root1 starts unbounded
+    std::vector<Index1> todo(1, root1);
+    while (!todo.empty()) {
+      bound[todo.back()] = (std::numeric_limits<Scalar>::max)();
+      tree1.getChildren(todo.back(), vBegin, vEnd, oBegin, oEnd);
+      todo.pop_back();
+      todo.insert(todo.end(), vBegin, vEnd);
+    }
+  }
+  internal::all_nearest_helper<BVH1, BVH2, Minimizer> helper(
+      tree1, tree2, minimizer, best, partner, bound);
+  helper.run(root1);
+}
+
+/**  BVAllNearest over all of \a tree1, best and partner are resized to
+  tree1.objs.size() */
+template <typename BVH1, typename BVH2, typename Minimizer>
+void BVAllNearest(const BVH1 &tree1, const BVH2 &tree2, Minimizer &minimizer,
+                  std::vector<typename Minimizer::Scalar> &best,
+                  std::vector<int> &partner) {
+  typedef typename Minimizer::Scalar Scalar;
+  best.assign(tree1.objs.size(), (std::numeric_limits<Scalar>::max)());
+  partner.assign(tree1.objs.size(), -1);
+  std::vector<Scalar> bound(tree1.vols.size());
+  BVAllNearest(tree1, tree2, minimizer, best.data(), partner.data(),
+               bound.data(), tree1.getRootIndex());
+}
+
 ////////////////////////////////////////////////////////////////////////
 ///////////////////////// Floor Minimizer ////////////////////////////
 ////////////////////////////////////////////////////////////////////////
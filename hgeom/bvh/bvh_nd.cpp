@@ -7,7 +7,8 @@ include = os.path.join(os.path.dirname(self.filename),'../..')
 cfg['include_dirs'] = [include, f'{include}/hgeom/extern']
 cfg['compiler_args'] = ['-std=c++17', '-w', '-Ofast']
 cfg['dependencies'] = ['../geom/primitive.hpp','../util/assertions.hpp',
-'../util/global_rng.hpp', 'bvh.hpp', 'bvh_algo.hpp', '../util/numeric.hpp']
+'../util/global_rng.hpp', 'bvh.hpp', 'bvh_algo.hpp', '../util/numeric.hpp',
+'../util/parallel.hpp']
 
 cfg['parallel'] = True
 
@@ -27,6 +28,7 @@ setup_pybind11(cfg)
 #include "hgeom/util/assertions.hpp"
 #include "hgeom/util/global_rng.hpp"
 #include "hgeom/util/numeric.hpp"
+#include "hgeom/util/parallel.hpp"
 #include "hgeom/util/types.hpp"
 #include "iostream"
 #include "miniball/Seb.h"
@@ -66,7 +68,7 @@ namespace hgeom {
 namespace bvh {
 
 template <typename F, int DIM> struct BoundingSphereND {
-  static SphereND<F, DIM> bound(auto pts) {
+  template <typename Pts> static SphereND<F, DIM> bound(Pts pts) {
     using Vn = Matrix<F, DIM, 1>;
     using Miniball =
         Seb::Smallest_enclosing_ball<F, decltype(pts[0]), decltype(pts)>;
@@ -103,15 +105,16 @@ template <typename F, int DIM> struct BVBVIsectND {
   F rad = 0, rad2 = 0;
   bool result = false;
 };
-template <typename F, int DIM>
-bool bvh_isect(BVH<F, DIM> &bvh1, BVH<F, DIM> &bvh2, F thresh) {
+template <typename F, int DIM, typename Tree = BVH<F, DIM>,
+          typename Query = BVBVIsectND<F, DIM>>
+bool bvh_isect_trees(Tree &bvh1, Tree &bvh2, F thresh) {
   py::gil_scoped_release release;
-  BVBVIsectND<F, DIM> query(thresh);
+  Query query(thresh);
   hgeom::bvh::BVIntersect(bvh1, bvh2, query);
   return query.result;
 }
 template <typename F, int DIM>
-bool bvh_isect_naive(BVH<F, DIM> &bvh1, BVH<F, DIM> &bvh2, F thresh) {
+bool bvh_isect_trees_naive(BVH<F, DIM> &bvh1, BVH<F, DIM> &bvh2, F thresh) {
   F dist2 = thresh * thresh;
   for (auto o1 : bvh1.objs) {
     for (auto o2 : bvh2.objs) {
@@ -141,29 +144,30 @@ template <typename F, int DIM> struct BVMinDistND {
     return d;
   }
 };
-template <typename F, int DIM>
-py::tuple bvh_mindist(BVH<F, DIM> &bvh, RefMxd pts) {
-  auto outm = std::make_unique<Vxd>();
-  auto outi = std::make_unique<Vxi>();
-
+template <typename F, int DIM, typename Tree = BVH<F, DIM>,
+          typename Query = BVMinDistND<F, DIM>>
+py::tuple bvh_mindist(Tree &bvh, RefMx<F> pts, int nthread) {
+  if (pts.cols() != DIM)
+    throw std::runtime_error("query points must be shape (N,DIM)");
+  Vx<F> outm(pts.rows());
+  Vxi outi(pts.rows());
   {
     py::gil_scoped_release release;
-    outm->resize(pts.rows());
-    outi->resize(pts.rows());
-    // double ncmp = 0;
-    for (int i = 0; i < pts.rows(); ++i) {
-      BVMinDistND<F, DIM> query(pts.row(i));
-      (*outm)[i] = hgeom::bvh::BVMinimize(bvh, query);
-      (*outi)[i] = query.imin;
-      // ncmp += query.ncmp;
-    }
-    // std::cout << "bvh ncmp " << ncmp / pts.rows() << std::endl;
+    // queries are independent, each thread reads the shared tree
+    parallel_for(
+        pts.rows(),
+        [&](size_t i) {
+          Query query(pts.row(i));
+          outm[i] = hgeom::bvh::BVMinimize(bvh, query);
+          outi[i] = query.imin;
+        },
+        nthread);
   }
-  return py::make_tuple(*outm, *outi);
+  return py::make_tuple(outm, outi);
 }
 template <typename F, int DIM>
-py::tuple bvh_mindist_naive(BVH<F, DIM> &bvh, RefMxd pts) {
-  Vxd outm(pts.rows());
+py::tuple bvh_mindist_naive(BVH<F, DIM> &bvh, RefMx<F> pts) {
+  Vx<F> outm(pts.rows());
   Vxi outi(pts.rows());
   // int64_t ncmp = 0;
   for (int i = 0; i < pts.rows(); ++i) {
@@ -200,19 +204,25 @@ template <typename F, int DIM> struct BVIsectND {
     return false;
   }
 };
-template <typename F, int DIM>
-Vxi bvh_isect(BVH<F, DIM> &bvh, RefMxd pts, F mindist) {
+template <typename F, int DIM, typename Tree = BVH<F, DIM>,
+          typename Query = BVIsectND<F, DIM>>
+Vxi bvh_isect(Tree &bvh, RefMx<F> pts, F mindist, int nthread) {
+  if (pts.cols() != DIM)
+    throw std::runtime_error("query points must be shape (N,DIM)");
   py::gil_scoped_release release;
   Vxi out(pts.rows());
-  for (int i = 0; i < pts.rows(); ++i) {
-    BVIsectND<F, DIM> query(pts.row(i), mindist);
-    hgeom::bvh::BVIntersect(bvh, query);
-    out[i] = query.i_isect;
-  }
+  parallel_for(
+      pts.rows(),
+      [&](size_t i) {
+        Query query(pts.row(i), mindist);
+        hgeom::bvh::BVIntersect(bvh, query);
+        out[i] = query.i_isect;
+      },
+      nthread);
   return out;
 }
 template <typename F, int DIM>
-Vxi bvh_isect_naive(BVH<F, DIM> &bvh, RefMxd pts, F mindist) {
+Vxi bvh_isect_naive(BVH<F, DIM> &bvh, RefMx<F> pts, F mindist) {
   Vxi out(pts.rows());
   out.fill(-1);
   for (int i = 0; i < pts.rows(); ++i) {
@@ -228,9 +238,24 @@ Vxi bvh_isect_naive(BVH<F, DIM> &bvh, RefMxd pts, F mindist) {
   return out;
 }
 
-template <typename F, int DIM> BVH<F, DIM> create_bvh_nd(RefMxd pts) {
+/*
+bound is how internal nodes are bounded: exact runs Miniball on every node's
+points, ritter is an O(n) approximation, merge encloses the two child spheres.
+see BoundMethod. nthread builds the top levels of the tree in parallel, 0 is
+all cores, and doesn't change the result
+*/
+inline BoundMethod bvh_nd_bound_method(std::string const &name) {
+  if (name == "exact") return BoundMethod::welzl;
+  if (name == "ritter") return BoundMethod::ritter;
+  if (name == "merge") return BoundMethod::merge;
+  throw std::runtime_error("argument 'bound' must be one of exact, ritter, merge");
+}
+template <typename F, int DIM>
+BVH<F, DIM> create_bvh_nd(RefMx<F> pts, std::string bound, int nthread) {
   if (pts.cols() != DIM)
     throw std::runtime_error("input must be shape (N,DIM)");
+  BoundMethod method = bvh_nd_bound_method(bound);
+  nthread = resolve_nthread(nthread, pts.rows());
   py::gil_scoped_release release;
   using Pt = Matrix<F, DIM, 1>;
   using Pi = PtIdxND<Pt>;
@@ -243,27 +268,594 @@ template <typename F, int DIM> BVH<F, DIM> create_bvh_nd(RefMxd pts) {
       pi.pos[j] = pts(i, j);
     objs.push_back(pi);
   }
-  return BVH(objs.begin(), objs.end());
+  return BVH(objs.begin(), objs.end(), method, nthread);
+}
+/*
+quaternion (DIM 4) or quaternion + translation (DIM 7) points, where q and -q
+are the same rotation. each point is stored once, flipped into the q[0] >= 0
+hemisphere, and the queries below measure min(|x - p|, |mirror(x) - p|) with
+mirror negating the quaternion part. that is the distance to a tree holding
+both copies of every point, so no boundary band needs duplicating, at half the
+objects
+*/
+template <typename F, int DIM> struct QuatBVH : BVH<F, DIM> {
+  using BVH<F, DIM>::BVH;
+};
+template <typename F, int DIM>
+Matrix<F, DIM, 1> quat_mirror(Matrix<F, DIM, 1> p) {
+  for (int j = 0; j < 4; ++j)
+    p[j] = -p[j];
+  return p;
 }
-template <typename F, int DIM> BVH<F, DIM> create_bvh_quatplus(RefMxd pts) {
+template <typename F, int DIM> struct BVMinDistQuat {
+  using Scalar = F;
+  using Sph = SphereND<F, DIM>;
+  using Obj = PtIdxND<Matrix<F, DIM, 1>>;
+  F mn = 9e9;
+  int imin = -1;
+  Matrix<F, DIM, 1> pt, ptm;
+  BVMinDistQuat(Matrix<F, DIM, 1> p) : pt(p), ptm(quat_mirror<F, DIM>(p)) {}
+  F minimumOnVolume(Sph s) { return std::min(s.signdis(pt), s.signdis(ptm)); }
+  F minimumOnObject(Obj o) {
+    F d = std::min((o.pos - pt).norm(), (o.pos - ptm).norm());
+    if (d < mn) {
+      imin = o.idx;
+      mn = d;
+    }
+    return d;
+  }
+};
+template <typename F, int DIM> struct BVIsectQuat {
+  using Sph = SphereND<F, DIM>;
+  using Obj = PtIdxND<Matrix<F, DIM, 1>>;
+  Matrix<F, DIM, 1> pt, ptm;
+  F mindist = 0, mindist2 = 0;
+  int i_isect = -1;
+  BVIsectQuat(Matrix<F, DIM, 1> p, F r)
+      : pt(p), ptm(quat_mirror<F, DIM>(p)), mindist(r), mindist2(r * r) {}
+  bool intersectVolume(Sph s) {
+    return s.signdis(pt) < mindist || s.signdis(ptm) < mindist;
+  }
+  bool intersectObject(Obj o) {
+    bool isect = (o.pos - pt).squaredNorm() < mindist2 ||
+                 (o.pos - ptm).squaredNorm() < mindist2;
+    if (isect) {
+      i_isect = o.idx;
+      return true;
+    }
+    return false;
+  }
+};
+// as BVBVIsectND, mirroring only tree1 as mirror is an isometry
+template <typename F, int DIM> struct BVBVIsectQuat {
+  using Sph = SphereND<F, DIM>;
+  using Obj = PtIdxND<Matrix<F, DIM, 1>>;
+  BVBVIsectQuat(F r) : rad(r), rad2(r * r) {}
+  bool intersectVolumeVolume(Sph s1, Sph s2) {
+    Sph m1(quat_mirror<F, DIM>(s1.cen), s1.rad);
+    return s1.signdis(s2) < rad || m1.signdis(s2) < rad;
+  }
+  bool intersectVolumeObject(Sph s1, Obj o2) {
+    return s1.signdis(o2.pos) < rad ||
+           s1.signdis(quat_mirror<F, DIM>(o2.pos)) < rad;
+  }
+  bool intersectObjectVolume(Obj o1, Sph s2) {
+    return s2.signdis(o1.pos) < rad ||
+           s2.signdis(quat_mirror<F, DIM>(o1.pos)) < rad;
+  }
+  bool intersectObjectObject(Obj o1, Obj o2) {
+    bool isect = (o1.pos - o2.pos).squaredNorm() < rad2 ||
+                 (quat_mirror<F, DIM>(o1.pos) - o2.pos).squaredNorm() < rad2;
+    result |= isect;
+    return isect;
+  }
+  F rad = 0, rad2 = 0;
+  bool result = false;
+};
+template <typename F, int DIM>
+QuatBVH<F, DIM> create_bvh_quat(RefMx<F> pts, std::string bound,
+                                int nthread) {
   if (pts.cols() != DIM)
-    throw std::runtime_error("quat input must be shape (N,4)");
+    throw std::runtime_error("quat input must be shape (N,DIM)");
+  BoundMethod method = bvh_nd_bound_method(bound);
+  nthread = resolve_nthread(nthread, pts.rows());
   py::gil_scoped_release release;
   using Pt = Matrix<F, DIM, 1>;
   using Pi = PtIdxND<Pt>;
-  using BVH = BVH<F, DIM>;
   std::vector<Pi> objs;
   for (int i = 0; i < pts.rows(); ++i) {
     Pi pi;
     pi.idx = i;
     for (int j = 0; j < DIM; ++j)
       pi.pos[j] = pts(i, j);
-    objs.push_back(pi);
-    for (int j = 0; j < 4; ++j)
-      pi.pos[j] = -pi.pos[j];
+    if (pi.pos[0] < 0)
+      pi.pos = quat_mirror<F, DIM>(pi.pos);
     objs.push_back(pi);
   }
-  return BVH(objs.begin(), objs.end());
+  return QuatBVH<F, DIM>(objs.begin(), objs.end(), method, nthread);
+}
+template <typename F, int DIM>
+py::tuple bvh_mindist_quat_naive(QuatBVH<F, DIM> &bvh, RefMx<F> pts) {
+  Vx<F> outm(pts.rows());
+  Vxi outi(pts.rows());
+  for (int i = 0; i < pts.rows(); ++i) {
+    Matrix<F, DIM, 1> pt = pts.row(i), ptm = quat_mirror<F, DIM>(pt);
+    F mn2 = 9e9;
+    for (int j = 0; j < bvh.objs.size(); ++j) {
+      F d2 = std::min((bvh.objs[j].pos - pt).squaredNorm(),
+                      (bvh.objs[j].pos - ptm).squaredNorm());
+      if (d2 < mn2) {
+        mn2 = d2;
+        outi[i] = bvh.objs[j].idx;
+      }
+    }
+    outm[i] = std::sqrt(mn2);
+  }
+  return py::make_tuple(outm, outi);
+}
+template <typename F, int DIM>
+Vxi bvh_isect_quat_naive(QuatBVH<F, DIM> &bvh, RefMx<F> pts, F mindist) {
+  Vxi out(pts.rows());
+  out.fill(-1);
+  for (int i = 0; i < pts.rows(); ++i) {
+    Matrix<F, DIM, 1> pt = pts.row(i), ptm = quat_mirror<F, DIM>(pt);
+    for (int j = 0; j < bvh.objs.size(); ++j) {
+      F d2 = std::min((bvh.objs[j].pos - pt).squaredNorm(),
+                      (bvh.objs[j].pos - ptm).squaredNorm());
+      if (d2 < mindist * mindist) {
+        out[i] = j;
+        break;
+      }
+    }
+  }
+  return out;
+}
+template <typename F, int DIM>
+bool bvh_isect_trees_quat_naive(QuatBVH<F, DIM> &bvh1, QuatBVH<F, DIM> &bvh2,
+                                F thresh) {
+  F dist2 = thresh * thresh;
+  for (auto o1 : bvh1.objs) {
+    auto m1 = quat_mirror<F, DIM>(o1.pos);
+    for (auto o2 : bvh2.objs) {
+      auto d2 = std::min((o1.pos - o2.pos).squaredNorm(),
+                         (m1 - o2.pos).squaredNorm());
+      if (d2 < dist2)
+        return true;
+    }
+  }
+  return false;
+}
+
+/*
+ball tree over points of any dimension, for feature vectors whose DIM isn't
+one of the compiled SphereBVH instantiations. points are stored coordinate
+major (SoA) in tree order, so the leaf scans in knn and within stream one
+coordinate at a time over up to LEAF contiguous points and vectorize. nodes
+split at the median of the widest axis and are bounded as in
+bvh_nd_bound_method: exact (Miniball), ritter, or merge of the two children.
+node ids are preorder, so children always follow their parent
+*/
+template <typename _F> struct SphereBVHX {
+  using F = _F;
+  static int const LEAF = 16;
+  int dim = 0, npt = 0;
+  std::vector<F> coord; // coord[d * npt + i], point i in tree order
+  std::vector<int> idx; // input row of each point in tree order
+  std::vector<F> cen;   // cen[node * dim + d]
+  std::vector<F> rad;
+  std::vector<int> lo, hi, child; // child[2 * node], -1 at leaves
+
+  SphereBVHX() {}
+  SphereBVHX(RefMx<F> pts, BoundMethod method, int nthread)
+      : dim(pts.cols()), npt(pts.rows()) {
+    idx.resize(npt);
+    for (int i = 0; i < npt; ++i)
+      idx[i] = i;
+    if (npt > 0)
+      split(pts, 0, npt);
+    coord.resize((size_t)dim * npt);
+    for (int d = 0; d < dim; ++d)
+      for (int i = 0; i < npt; ++i)
+        coord[(size_t)d * npt + i] = pts(idx[i], d);
+    int nnode = lo.size();
+    cen.resize((size_t)nnode * dim);
+    rad.resize(nnode);
+    if (method == BoundMethod::merge) {
+      for (int node = nnode - 1; node >= 0; --node)
+        if (child[2 * node] < 0)
+          ritter(node);
+        else
+          merge(node);
+    } else {
+      parallel_for(
+          nnode,
+          [&](size_t node) {
+            if (method == BoundMethod::welzl)
+              miniball(node);
+            else
+              ritter(node);
+          },
+          nthread);
+    }
+  }
+  int size() const { return npt; }
+  F x(int i, int d) const { return coord[(size_t)d * npt + i]; }
+
+  int split(RefMx<F> const &pts, int from, int to) {
+    int node = lo.size();
+    lo.push_back(from);
+    hi.push_back(to);
+    child.push_back(-1);
+    child.push_back(-1);
+    if (to - from <= LEAF)
+      return node;
+    int axis = 0;
+    F best = -1;
+    for (int d = 0; d < dim; ++d) {
+      F mn = pts(idx[from], d), mx = mn;
+      for (int i = from + 1; i < to; ++i) {
+        mn = std::min(mn, pts(idx[i], d));
+        mx = std::max(mx, pts(idx[i], d));
+      }
+      if (mx - mn > best)
+        best = mx - mn, axis = d;
+    }
+    int mid = from + (to - from) / 2;
+    std::nth_element(&idx[from], &idx[mid], &idx[from] + (to - from),
+                     [&](int a, int b) {
+                       F xa = pts(a, axis), xb = pts(b, axis);
+                       return xa < xb || (xa == xb && a < b);
+                     });
+    int c0 = split(pts, from, mid);
+    int c1 = split(pts, mid, to);
+    child[2 * node] = c0;
+    child[2 * node + 1] = c1;
+    return node;
+  }
+
+  // radius about the node center that takes in all the node's points
+  void refit(int node) {
+    F *c = &cen[(size_t)node * dim];
+    F mx = 0;
+    for (int i = lo[node]; i < hi[node]; ++i) {
+      F d2 = 0;
+      for (int d = 0; d < dim; ++d)
+        d2 += (x(i, d) - c[d]) * (x(i, d) - c[d]);
+      mx = std::max(mx, d2);
+    }
+    rad[node] = std::sqrt(mx) + epsilon2<F>();
+  }
+  // same procedure as ritter_bounding_ball, on the SoA points
+  void ritter(int node) {
+    int from = lo[node], to = hi[node];
+    F *c = &cen[(size_t)node * dim];
+    auto dist2 = [&](int i, int j) {
+      F d2 = 0;
+      for (int d = 0; d < dim; ++d)
+        d2 += (x(i, d) - x(j, d)) * (x(i, d) - x(j, d));
+      return d2;
+    };
+    int mn = from, mx = from;
+    F best = -1;
+    for (int d = 0; d < dim; ++d) {
+      int l = from, h = from;
+      for (int i = from + 1; i < to; ++i) {
+        if (x(i, d) < x(l, d)) l = i;
+        if (x(i, d) > x(h, d)) h = i;
+      }
+      F d2 = dist2(l, h);
+      if (d2 > best)
+        best = d2, mn = l, mx = h;
+    }
+    for (int d = 0; d < dim; ++d)
+      c[d] = (x(mn, d) + x(mx, d)) / 2;
+    F r = std::sqrt(best) / 2;
+    for (int i = from; i < to; ++i) {
+      F d2 = 0;
+      for (int d = 0; d < dim; ++d)
+        d2 += (x(i, d) - c[d]) * (x(i, d) - c[d]);
+      if (d2 > r * r) {
+        F dist = std::sqrt(d2), newr = (r + dist) / 2;
+        for (int d = 0; d < dim; ++d)
+          c[d] += (x(i, d) - c[d]) * ((newr - r) / dist);
+        r = newr;
+      }
+    }
+    refit(node);
+  }
+  struct SoAPoint {
+    F const *p;
+    int stride;
+    F operator[](unsigned d) const { return p[(size_t)d * stride]; }
+  };
+  struct SoAPoints {
+    F const *p;
+    int stride, n;
+    SoAPoint operator[](size_t i) const { return SoAPoint{p + i, stride}; }
+    size_t size() const { return n; }
+  };
+  void miniball(int node) {
+    using Miniball = Seb::Smallest_enclosing_ball<F, SoAPoint, SoAPoints>;
+    // Miniball keeps a reference to the points, so they must outlive it
+    SoAPoints pts{&coord[lo[node]], npt, hi[node] - lo[node]};
+    Miniball mb(dim, pts);
+    auto cen_it = mb.center_begin();
+    for (int d = 0; d < dim; ++d)
+      cen[(size_t)node * dim + d] = cen_it[d];
+    // miniball's own radius can come out a hair short in float
+    refit(node);
+  }
+  // as SphereND::merged
+  void merge(int node) {
+    int a = child[2 * node], b = child[2 * node + 1];
+    F *c = &cen[(size_t)node * dim];
+    F const *ca = &cen[(size_t)a * dim], *cb = &cen[(size_t)b * dim];
+    F dab = 0;
+    for (int d = 0; d < dim; ++d)
+      dab += (cb[d] - ca[d]) * (cb[d] - ca[d]);
+    dab = std::sqrt(dab);
+    if (dab + rad[b] <= rad[a] || dab + rad[a] <= rad[b]) {
+      int big = rad[a] >= rad[b] ? a : b;
+      std::copy_n(&cen[(size_t)big * dim], dim, c);
+      rad[node] = rad[big];
+      return;
+    }
+    F r = (rad[a] + rad[b] + dab) / 2;
+    for (int d = 0; d < dim; ++d)
+      c[d] = ca[d] + (cb[d] - ca[d]) / dab * (r - rad[a]);
+    rad[node] = r + epsilon2<F>() / 2;
+  }
+
+  // the query kernels take the dim as template parameter D so the
+  // coordinate loops unroll, D = 0 loops over the runtime dim
+  static int const MAXDIM = 16;
+  template <int D = 3, typename Func> void with_dim(Func &&func) const {
+    if constexpr (D > MAXDIM)
+      func(std::integral_constant<int, 0>());
+    else if (dim == D)
+      func(std::integral_constant<int, D>());
+    else
+      with_dim<D + 1>(func);
+  }
+
+  // lower bound on the distance from q to any point under node
+  template <int D> F signdis(F const *q, int node) const {
+    int const nd = D ? D : dim;
+    F const *c = &cen[(size_t)node * nd];
+    F d2 = 0;
+    for (int d = 0; d < nd; ++d)
+      d2 += (q[d] - c[d]) * (q[d] - c[d]);
+    return std::sqrt(d2) - rad[node];
+  }
+  // squared distances from q to the points of leaf node, one coordinate at a
+  // time so the inner loop runs over contiguous points
+  template <int D> int leaf_dist2(F const *q, int node, F *d2) const {
+    int const nd = D ? D : dim;
+    int from = lo[node], n = hi[node] - from;
+    std::fill_n(d2, n, F(0));
+    for (int d = 0; d < nd; ++d) {
+      F const *c = &coord[(size_t)d * npt + from];
+      F qd = q[d];
+      for (int i = 0; i < n; ++i)
+        d2[i] += (c[i] - qd) * (c[i] - qd);
+    }
+    return n;
+  }
+
+  // input rows of all points within r of q, ascending
+  void within(F const *q, F r, std::vector<int> &out) const {
+    with_dim([&](auto D) { within<decltype(D)::value>(q, r, out); });
+  }
+  // k nearest points to q, closest first, padded with inf / -1 if k > npt
+  void knn(F const *q, int k, F *dist, int *ids) const {
+    with_dim([&](auto D) { knn<decltype(D)::value>(q, k, dist, ids); });
+  }
+  template <int D> void within(F const *q, F r, std::vector<int> &out) const {
+    if (npt == 0)
+      return;
+    F d2[LEAF];
+    std::vector<int> todo(1, 0);
+    while (!todo.empty()) {
+      int node = todo.back();
+      todo.pop_back();
+      if (signdis<D>(q, node) > r)
+        continue;
+      if (child[2 * node] >= 0) {
+        todo.push_back(child[2 * node]);
+        todo.push_back(child[2 * node + 1]);
+        continue;
+      }
+      int n = leaf_dist2<D>(q, node, d2);
+      for (int i = 0; i < n; ++i)
+        if (d2[i] <= r * r)
+          out.push_back(idx[lo[node] + i]);
+    }
+    std::sort(out.begin(), out.end());
+  }
+  template <int D> void knn(F const *q, int k, F *dist, int *ids) const {
+    using QueueElement = std::pair<F, int>;
+    std::priority_queue<QueueElement, std::vector<QueueElement>,
+                        std::greater<QueueElement>>
+        todo;
+    std::vector<std::pair<F, int>> best; // (d2, row), max heap
+    F d2[LEAF], kth = std::numeric_limits<F>::max();
+    if (npt > 0)
+      todo.emplace(signdis<D>(q, 0), 0);
+    while (!todo.empty() && todo.top().first < kth) {
+      int node = todo.top().second;
+      todo.pop();
+      if (child[2 * node] >= 0) {
+        for (int j = 0; j < 2; ++j) {
+          int c = child[2 * node + j];
+          F lb = signdis<D>(q, c);
+          if (lb < kth)
+            todo.emplace(lb, c);
+        }
+        continue;
+      }
+      int n = leaf_dist2<D>(q, node, d2);
+      for (int i = 0; i < n; ++i) {
+        std::pair<F, int> cand(d2[i], idx[lo[node] + i]);
+        if ((int)best.size() < k) {
+          best.push_back(cand);
+          std::push_heap(best.begin(), best.end());
+        } else if (cand < best.front()) {
+          std::pop_heap(best.begin(), best.end());
+          best.back() = cand;
+          std::push_heap(best.begin(), best.end());
+        }
+      }
+      if ((int)best.size() == k)
+        kth = std::sqrt(best.front().first);
+    }
+    std::sort_heap(best.begin(), best.end());
+    for (int j = 0; j < k; ++j) {
+      bool found = j < (int)best.size();
+      dist[j] = found ? std::sqrt(best[j].first)
+                      : std::numeric_limits<F>::infinity();
+      ids[j] = found ? best[j].second : -1;
+    }
+  }
+};
+
+/*
+knn and radius queries on the fixed DIM trees, the same results as
+SphereBVHX::knn and SphereBVHX::within
+*/
+template <typename F, int DIM> struct BVKnnND {
+  using Scalar = F;
+  using Sph = SphereND<F, DIM>;
+  using Obj = PtIdxND<Matrix<F, DIM, 1>>;
+  Matrix<F, DIM, 1> pt;
+  int k;
+  std::vector<std::pair<F, int>> best; // (dist, idx), max heap
+  BVKnnND(Matrix<F, DIM, 1> p, int k) : pt(p), k(k) {}
+  F minimumOnVolume(Sph s) { return s.signdis(pt); }
+  F minimumOnObject(Obj o) {
+    std::pair<F, int> cand((o.pos - pt).norm(), o.idx);
+    if ((int)best.size() < k) {
+      best.push_back(cand);
+      std::push_heap(best.begin(), best.end());
+    } else if (cand < best.front()) {
+      std::pop_heap(best.begin(), best.end());
+      best.back() = cand;
+      std::push_heap(best.begin(), best.end());
+    }
+    // objects are pruned against the kth distance once there are k
+    return (int)best.size() < k ? std::numeric_limits<F>::max()
+                                : best.front().first;
+  }
+};
+template <typename F, int DIM> struct BVWithinND {
+  using Sph = SphereND<F, DIM>;
+  using Obj = PtIdxND<Matrix<F, DIM, 1>>;
+  Matrix<F, DIM, 1> pt;
+  F rad, rad2;
+  std::vector<int> &out;
+  BVWithinND(Matrix<F, DIM, 1> p, F r, std::vector<int> &o)
+      : pt(p), rad(r), rad2(r * r), out(o) {}
+  bool intersectVolume(Sph s) { return s.signdis(pt) <= rad; }
+  bool intersectObject(Obj o) {
+    if ((o.pos - pt).squaredNorm() <= rad2)
+      out.push_back(o.idx);
+    return false;
+  }
+};
+template <typename F, int DIM>
+void bvh_knn_one(BVH<F, DIM> const &bvh, F const *q, int k, F *dist,
+                 int *ids) {
+  BVKnnND<F, DIM> query(Map<Matrix<F, DIM, 1> const>(q), k);
+  hgeom::bvh::BVMinimize(bvh, query);
+  std::sort_heap(query.best.begin(), query.best.end());
+  for (int j = 0; j < k; ++j) {
+    bool found = j < (int)query.best.size();
+    dist[j] = found ? query.best[j].first : std::numeric_limits<F>::infinity();
+    ids[j] = found ? query.best[j].second : -1;
+  }
+}
+template <typename F>
+void bvh_knn_one(SphereBVHX<F> const &bvh, F const *q, int k, F *dist,
+                 int *ids) {
+  bvh.knn(q, k, dist, ids);
+}
+template <typename F, int DIM>
+void bvh_within_one(BVH<F, DIM> const &bvh, F const *q, F r,
+                    std::vector<int> &out) {
+  BVWithinND<F, DIM> query(Map<Matrix<F, DIM, 1> const>(q), r, out);
+  hgeom::bvh::BVIntersect(bvh, query);
+  std::sort(out.begin(), out.end());
+}
+template <typename F>
+void bvh_within_one(SphereBVHX<F> const &bvh, F const *q, F r,
+                    std::vector<int> &out) {
+  bvh.within(q, r, out);
+}
+template <typename F, int DIM> int bvh_dim(BVH<F, DIM> const &) { return DIM; }
+template <typename F> int bvh_dim(SphereBVHX<F> const &bvh) { return bvh.dim; }
+
+/*
+batched queries on create_bvh_nd trees and the 4D/7D trees. knn gives (N,k)
+distances and input rows, closest first. radius gives (M,2) pairs of (query
+row, input row) within r, sorted
+*/
+template <typename F, typename Tree>
+py::tuple bvh_knn(Tree &bvh, RefMx<F> pts, int k, int nthread) {
+  if (pts.cols() != bvh_dim(bvh))
+    throw std::runtime_error("query points must be shape (N,DIM)");
+  if (k < 1)
+    throw std::runtime_error("k must be positive");
+  Mx<F> dist(pts.rows(), k);
+  Mx<int> ids(pts.rows(), k);
+  {
+    py::gil_scoped_release release;
+    parallel_for(
+        pts.rows(),
+        [&](size_t i) {
+          bvh_knn_one(bvh, pts.row(i).data(), k, dist.row(i).data(),
+                      ids.row(i).data());
+        },
+        nthread);
+  }
+  return py::make_tuple(dist, ids);
+}
+template <typename F, typename Tree>
+Mx<int> bvh_radius(Tree &bvh, RefMx<F> pts, F radius, int nthread) {
+  if (pts.cols() != bvh_dim(bvh))
+    throw std::runtime_error("query points must be shape (N,DIM)");
+  py::gil_scoped_release release;
+  std::vector<std::vector<int>> hits(pts.rows());
+  parallel_for(
+      pts.rows(),
+      [&](size_t i) { bvh_within_one(bvh, pts.row(i).data(), radius, hits[i]); },
+      nthread);
+  size_t n = 0;
+  for (auto const &h : hits)
+    n += h.size();
+  Mx<int> out(n, 2);
+  n = 0;
+  for (int i = 0; i < pts.rows(); ++i)
+    for (int j : hits[i]) {
+      out(n, 0) = i;
+      out(n, 1) = j;
+      ++n;
+    }
+  return out;
+}
+
+/*
+tree over (N,DIM) feature vectors of any DIM, always a SphereBVHX. its
+multi-point SoA leaves run knn faster than the one point per leaf fixed-DIM
+trees even at DIM 5 to 8, which stay for the 4D/7D mindist and isect API
+*/
+template <typename F>
+SphereBVHX<F> create_bvh_anydim(RefMx<F> pts, std::string bound,
+                                int nthread) {
+  if (pts.cols() < 1)
+    throw std::runtime_error("input must be shape (N,DIM)");
+  BoundMethod method = bvh_nd_bound_method(bound);
+  nthread = resolve_nthread(nthread, pts.rows());
+  py::gil_scoped_release release;
+  return SphereBVHX<F>(pts, method, nthread);
 }
 
 template <typename BVH>
@@ -289,33 +881,105 @@ Matrix<typename BVH::F, BVH::DIM, 1> bvh_obj_com(BVH &b) {
   return com;
 }
 
-template <typename F, int DIM> void bind_bvh_ND(auto m, std::string name) {
-  using BVH = BVH<F, DIM>;
+template <typename F, int DIM, typename Tree = BVH<F, DIM>>
+void bind_bvh_ND(py::module_ m, std::string name) {
+  py::class_<Tree>(m, name.c_str())
+      .def("__len__", [](Tree &b) { return b.objs.size(); })
+      .def("radius", [](Tree &b) { return b.vols[b.getRootIndex()].rad; })
+      .def("center", [](Tree &b) { return b.vols[b.getRootIndex()].cen; })
+      .def("centers", &bvh_obj_centers<Tree>)
+      .def("com", &bvh_obj_com<Tree>)
+      .def("quality", [](Tree const &b) {
+        BVHQuality q = b.quality();
+        return py::dict("nvol"_a = q.nvol, "maxdepth"_a = q.maxdepth,
+                        "meandepth"_a = q.meandepth, "sumrad"_a = q.sumrad,
+                        "overlap"_a = q.overlap);
+      })
+      /**/;
+}
+
+template <typename F> void bind_bvh_X(py::module_ m, std::string name) {
+  using BVH = SphereBVHX<F>;
   py::class_<BVH>(m, name.c_str())
-      .def("__len__", [](BVH &b) { return b.objs.size(); })
-      .def("radius", [](BVH &b) { return b.vols[b.getRootIndex()].rad; })
-      .def("center", [](BVH &b) { return b.vols[b.getRootIndex()].cen; })
-      .def("centers", &bvh_obj_centers<BVH>)
-      .def("com", &bvh_obj_com<BVH>)
+      .def("__len__", &BVH::size)
+      .def_readonly("dim", &BVH::dim)
+      .def("radius", [](BVH &b) { return b.npt ? b.rad[0] : F(0); })
+      .def("center",
+           [](BVH &b) {
+             Vx<F> cen = Vx<F>::Zero(b.dim);
+             for (int d = 0; d < b.dim && b.npt; ++d)
+               cen[d] = b.cen[d];
+             return cen;
+           })
       /**/;
 }
+template <typename F, typename Tree> void bind_bvh_knn(py::module_ m) {
+  m.def("bvh_knn", &bvh_knn<F, Tree>, "bvh"_a, "pts"_a, "k"_a,
+        "nthread"_a = 0);
+  m.def("bvh_radius", &bvh_radius<F, Tree>, "bvh"_a, "pts"_a, "radius"_a,
+        "nthread"_a = 0);
+}
+
+/*
+each query function is overloaded on the tree precision: float64 query points
+go with trees built from float64 points, float32 with float32
+*/
+template <typename F> void bind_bvh_nd_funcs(py::module_ m, std::string sfx) {
+  bind_bvh_ND<F, 7>(m, "SphereBVH7D" + sfx);
+  m.def("create_bvh7d", &create_bvh_nd<F, 7>, "pts"_a, "bound"_a = "exact",
+        "nthread"_a = 0);
+  m.def("bvh_isect7d", &bvh_isect_trees<F, 7>);
+  m.def("bvh_isect7d_naive", &bvh_isect_trees_naive<F, 7>);
+  m.def("bvh_isect7d", &bvh_isect<F, 7>, "bvh"_a, "pts"_a, "mindist"_a,
+        "nthread"_a = 0);
+  m.def("bvh_isect7d_naive", &bvh_isect_naive<F, 7>);
+  m.def("bvh_mindist7d", &bvh_mindist<F, 7>, "bvh"_a, "pts"_a,
+        "nthread"_a = 0);
+  m.def("bvh_mindist7d_naive", &bvh_mindist_naive<F, 7>);
+
+  bind_bvh_ND<F, 4>(m, "SphereBVH4D" + sfx);
+  m.def("create_bvh4d", &create_bvh_nd<F, 4>, "pts"_a, "bound"_a = "exact",
+        "nthread"_a = 0);
+  m.def("bvh_mindist4d", &bvh_mindist<F, 4>, "bvh"_a, "pts"_a,
+        "nthread"_a = 0);
+  m.def("bvh_mindist4d_naive", &bvh_mindist_naive<F, 4>);
+
+  // rotations as quaternions, q and -q equivalent, see QuatBVH
+  bind_bvh_ND<F, 7, QuatBVH<F, 7>>(m, "XformBVH7D" + sfx);
+  m.def("create_bvh_xform", &create_bvh_quat<F, 7>, "pts"_a,
+        "bound"_a = "exact", "nthread"_a = 0);
+  m.def("bvh_isect7d",
+        &bvh_isect_trees<F, 7, QuatBVH<F, 7>, BVBVIsectQuat<F, 7>>);
+  m.def("bvh_isect7d_naive", &bvh_isect_trees_quat_naive<F, 7>);
+  m.def("bvh_isect7d",
+        &bvh_isect<F, 7, QuatBVH<F, 7>, BVIsectQuat<F, 7>>, "bvh"_a,
+        "pts"_a, "mindist"_a, "nthread"_a = 0);
+  m.def("bvh_isect7d_naive", &bvh_isect_quat_naive<F, 7>);
+  m.def("bvh_mindist7d",
+        &bvh_mindist<F, 7, QuatBVH<F, 7>, BVMinDistQuat<F, 7>>, "bvh"_a,
+        "pts"_a, "nthread"_a = 0);
+  m.def("bvh_mindist7d_naive", &bvh_mindist_quat_naive<F, 7>);
+
+  bind_bvh_ND<F, 4, QuatBVH<F, 4>>(m, "QuatBVH4D" + sfx);
+  m.def("create_bvh_quat", &create_bvh_quat<F, 4>, "pts"_a,
+        "bound"_a = "exact", "nthread"_a = 0);
+  m.def("bvh_mindist4d",
+        &bvh_mindist<F, 4, QuatBVH<F, 4>, BVMinDistQuat<F, 4>>, "bvh"_a,
+        "pts"_a, "nthread"_a = 0);
+  m.def("bvh_mindist4d_naive", &bvh_mindist_quat_naive<F, 4>);
+
+  // feature vectors of any DIM, see create_bvh_anydim
+  bind_bvh_X<F>(m, "SphereBVHX" + sfx);
+  m.def("create_bvh_nd", &create_bvh_anydim<F>, "pts"_a, "bound"_a = "exact",
+        "nthread"_a = 0);
+  bind_bvh_knn<F, SphereBVHX<F>>(m);
+  bind_bvh_knn<F, BVH<F, 4>>(m);
+  bind_bvh_knn<F, BVH<F, 7>>(m);
+}
 
 PYBIND11_MODULE(_bvh_nd, m) {
-  bind_bvh_ND<double, 7>(m, "SphereBVH7D");
-  m.def("create_bvh7d", &create_bvh_nd<double, 7>);
-  m.def("bvh_isect7d", &bvh_isect<double, 7>);
-  m.def("bvh_isect7d_naive", &bvh_isect_naive<double, 7>);
-  m.def("bvh_isect7d", &bvh_isect<double, 7>);
-  m.def("bvh_isect7d_naive", &bvh_isect_naive<double, 7>);
-  m.def("bvh_mindist7d", &bvh_mindist<double, 7>);
-  m.def("bvh_mindist7d_naive", &bvh_mindist_naive<double, 7>);
-  m.def("create_bvh_xform", &create_bvh_quatplus<double, 7>);
-
-  bind_bvh_ND<double, 4>(m, "SphereBVH4D");
-  m.def("create_bvh4d", &create_bvh_nd<double, 4>);
-  m.def("create_bvh_quat", &create_bvh_quatplus<double, 4>);
-  m.def("bvh_mindist4d", &bvh_mindist<double, 4>);
-  m.def("bvh_mindist4d_naive", &bvh_mindist_naive<double, 4>);
+  bind_bvh_nd_funcs<double>(m, "");
+  bind_bvh_nd_funcs<float>(m, "_float");
 }
 } // namespace bvh
 } // namespace hgeom
@@ -23,6 +23,9 @@ template <class F> class Sphere {
     F rad;
     int lb = 2000000000;
     int ub = -2000000000;
+    // bit k set if the objects inside hold an id in block k of [lb, ub] cut
+    // in 64 blocks, all set when unknown
+    uint64_t idblocks = ~uint64_t(0);
 
     Sphere() : cen(0, 0, 0), rad(1) {}
     Sphere(Vec3 c, F r) : cen(c), rad(r) {}
@@ -235,6 +238,60 @@ template <class Ary> auto most_separated_points_on_AABB(Ary const &pt) {
     return std::make_pair(pt[mn], pt[mx]);
 }
 
+/**
+ * @brief      Ritter's approximate bounding ball in any dimension, returned as
+ * Sph (Sphere or SphereND). Starts from the most separated pair of AABB
+ * extreme points and grows to take in each point left outside, one pass. The
+ * radius is then refit about the final center, so the ball is typically
+ * within 5-20% of the minimal one at O(n * dim) cost.
+ */
+template <class Sph, bool range = false, class Ary>
+Sph ritter_bounding_ball(Ary const &points) noexcept {
+    using Pt = typename Ary::value_type;
+    using Scalar = typename Pt::Scalar;
+    Pt cen = Pt::Zero();
+    Scalar rad = -1;
+    if (points.size() > 0) {
+        // extreme points along each axis, keep the farthest apart pair
+        size_t mn = 0, mx = 0;
+        Scalar best = -1;
+        for (int d = 0; d < cen.size(); ++d) {
+            size_t lo = 0, hi = 0;
+            for (size_t i = 1; i < points.size(); i++) {
+                if (points[i][d] < points[lo][d]) lo = i;
+                if (points[i][d] > points[hi][d]) hi = i;
+            }
+            Scalar dist2 = (points[hi] - points[lo]).squaredNorm();
+            if (dist2 > best) best = dist2, mn = lo, mx = hi;
+        }
+        cen = (points[mn] + points[mx]) / 2;
+        Scalar r = (points[mx] - cen).norm();
+        for (size_t i = 0; i < points.size(); i++) {
+            Pt d = points[i] - cen;
+            Scalar dist2 = d.squaredNorm();
+            if (dist2 > r * r) {
+                Scalar dist = sqrt(dist2);
+                Scalar newr = (r + dist) / 2;
+                cen += d * ((newr - r) / dist);
+                r = newr;
+            }
+        }
+        for (size_t i = 0; i < points.size(); i++) {
+            Scalar d2 = (points[i] - cen).squaredNorm();
+            if (d2 > rad) rad = d2;
+        }
+        rad = sqrt(rad) + epsilon2<Scalar>();
+    }
+    Sph bound(cen, rad);
+    UpdateBounds<Ary, Sph, range>::update_bounds(points, bound);
+    return bound;
+}
+template <bool range = false, class Ary>
+auto ritter_bounding_sphere(Ary const &points) noexcept {
+    using Scalar = typename Ary::value_type::Scalar;
+    return ritter_bounding_ball<Sphere<Scalar>, range>(points);
+}
+
 template <typename F, int DIM> struct SphereND {
     using This = SphereND<F, DIM>;
     using Vn = Eigen::Matrix<F, DIM, 1>;
@@ -1197,6 +1197,541 @@ def test_bvh_threading_mindist_may_fail():
     print('bvh_min_dist', tottmain / tottthread)
 
 
+def helper_test_bvh_score_pairs_binned(Bvh, dtype):
+    N, Npts, ntype, nbins = 20, 300, 4, 6
+    maxdist = 0.1
+    xyz1 = np.random.rand(Npts, 3) - [0.5, 0.5, 0.5]
+    xyz2 = np.random.rand(Npts, 3) - [0.5, 0.5, 0.5]
+    bvh1 = Bvh(xyz1)
+    bvh2 = Bvh(xyz2)
+    types1 = np.random.randint(ntype, size=Npts)
+    types2 = np.random.randint(ntype, size=Npts)
+    table = np.random.randn(ntype, ntype, nbins).astype(dtype)
+    pos1 = hm.rand_xform(N, cart_sd=0.4).astype(dtype)
+    pos2 = hm.rand_xform(N, cart_sd=0.4).astype(dtype)
+
+    score = wu.bvh_score_pairs_binned(bvh1, bvh2, pos1, pos2, maxdist, types1, types2, table)
+    assert score.shape == (N,)
+    for i in range(N):
+        naive = wu.naive_score_pairs_binned(bvh1, bvh2, pos1[i], pos2[i], maxdist, types1, types2, table)
+        assert np.allclose(score[i], naive, atol=1e-4)
+
+    score2, res1, res2 = wu.bvh_score_pairs_binned(
+        bvh1, bvh2, pos1, pos2, maxdist, types1, types2, table, per_res=True
+    )
+    assert np.allclose(score, score2)
+    assert res1.shape == (N, Npts)
+    assert res2.shape == (N, Npts)
+    assert np.allclose(res1.sum(axis=1), score, atol=1e-4)
+    assert np.allclose(res2.sum(axis=1), score, atol=1e-4)
+    score1, res11, res21 = wu.bvh_score_pairs_binned(
+        bvh1, bvh2, pos1, pos2, maxdist, types1, types2, table, per_res=True, nthread=1
+    )
+    assert np.all(score1 == score2)
+    assert np.all(res11 == res1)
+    assert np.all(res21 == res2)
+
+    for bad in [table[:, :, :0], table[:0, :0]]:
+        try:
+            wu.bvh_score_pairs_binned(bvh1, bvh2, pos1, pos2, maxdist, types1, types2, bad)
+            assert 0, 'empty table should raise'
+        except RuntimeError:
+            pass
+
+
+def test_bvh_score_pairs_binned_double():
+    helper_test_bvh_score_pairs_binned(SphereBVH_double, 'f8')
+
+
+def test_bvh_score_pairs_binned_float():
+    helper_test_bvh_score_pairs_binned(SphereBVH_float, 'f4')
+
+def test_bvh_count_pairs_hist():
+    N, Npts = 30, 500
+    xyz1 = np.random.rand(Npts, 3) - [0.5, 0.5, 0.5]
+    xyz2 = np.random.rand(Npts, 3) - [0.5, 0.5, 0.5]
+    bvh1 = SphereBVH_double(xyz1)
+    bvh2 = SphereBVH_double(xyz2)
+    pos1 = hm.rand_xform(N, cart_sd=0.4)
+    pos2 = hm.rand_xform(N, cart_sd=0.4)
+    edges = np.array([0.0, 0.02, 0.04, 0.06, 0.08, 0.1])
+
+    hist = wu.bvh_count_pairs_hist(bvh1, bvh2, pos1, pos2, edges)
+    assert hist.shape == (N, len(edges) - 1)
+    for ie, e in enumerate(edges[1:]):
+        count = wu.bvh_count_pairs_vec(bvh1, bvh2, pos1, pos2, e)
+        assert np.all(count == hist[:, : ie + 1].sum(axis=1))
+
+    hist1 = wu.bvh_count_pairs_hist(bvh1, bvh2, pos1, pos2, edges, nthread=1)
+    assert np.all(hist1 == hist)
+    hist2 = wu.bvh_count_pairs_hist(bvh1, bvh2, pos1[0], pos2, edges)
+    assert hist2.shape == hist.shape
+    assert np.all(hist2[0] == hist[0])
+
+def test_bvh_multi_query_vec():
+    N, Npts = 50, 500
+    xyz1 = np.random.rand(Npts, 3) - [0.5, 0.5, 0.5]
+    xyz2 = np.random.rand(Npts, 3) - [0.5, 0.5, 0.5]
+    bvh1 = SphereBVH_double(xyz1)
+    bvh2 = SphereBVH_double(xyz2)
+    pos1 = hm.rand_xform(N, cart_sd=0.6)
+    pos2 = hm.rand_xform(N, cart_sd=0.6)
+    mindist, maxdist = 0.02, 0.05
+
+    isect, mindis, idx1, idx2, npair = wu.bvh_multi_query_vec(bvh1, bvh2, pos1, pos2, mindist, maxdist)
+    assert np.all(isect == wu.bvh_isect_vec(bvh1, bvh2, pos1, pos2, mindist))
+    d, i1, i2 = wu.bvh_min_dist_vec(bvh1, bvh2, pos1, pos2)
+    assert np.allclose(mindis, d)
+    assert np.all(npair == wu.bvh_count_pairs_vec(bvh1, bvh2, pos1, pos2, maxdist))
+    p1 = np.einsum('nij,nj->ni', pos1, hm.hpoint(xyz1[idx1]))
+    p2 = np.einsum('nij,nj->ni', pos2, hm.hpoint(xyz2[idx2]))
+    assert np.allclose(np.linalg.norm(p1 - p2, axis=1), mindis)
+
+def test_bvh_all_nearest_vec():
+    N, Npts1, Npts2 = 10, 300, 400
+    xyz1 = np.random.rand(Npts1, 3) - [0.5, 0.5, 0.5]
+    xyz2 = np.random.rand(Npts2, 3) - [0.5, 0.5, 0.5]
+    bvh1 = SphereBVH_double(xyz1)
+    bvh2 = SphereBVH_double(xyz2)
+    pos1 = hm.rand_xform(N, cart_sd=0.5)
+    pos2 = hm.rand_xform(N, cart_sd=0.5)
+
+    dist, partner, hdir = wu.bvh_all_nearest_vec(bvh1, bvh2, pos1, pos2)
+    haus = wu.bvh_hausdorff_vec(bvh1, bvh2, pos1, pos2)
+    assert dist.shape == (N, Npts1) and partner.shape == (N, Npts1)
+    for i in range(N):
+        p1 = (pos1[i] @ hm.hpoint(xyz1)[..., None]).squeeze()
+        p2 = (pos2[i] @ hm.hpoint(xyz2)[..., None]).squeeze()
+        d = np.linalg.norm(p1[:, None] - p2[None], axis=2)
+        assert np.allclose(dist[i], d.min(axis=1))
+        assert np.allclose(d[np.arange(Npts1), partner[i]], dist[i])
+        assert np.allclose(hdir[i], d.min(axis=1).max())
+        assert np.allclose(haus[i], max(d.min(axis=1).max(), d.min(axis=0).max()))
+
+    # one pose spreads subtrees of bvh1 over the threads
+    dist1, partner1, hdir1 = wu.bvh_all_nearest_vec(bvh1, bvh2, pos1[:1], pos2[:1], nthread=4)
+    assert np.allclose(dist1, dist[:1]) and np.all(partner1 == partner[:1])
+    assert np.allclose(wu.bvh_hausdorff_vec(bvh1, bvh2, pos1[:1], pos2[:1], nthread=4), haus[:1])
+
+def test_bvh_mask_vec():
+    N, Npts, Nids = 20, 1000, 200
+    ids = np.repeat(np.arange(Nids), Npts // Nids)
+    xyz1 = random_walk(Npts)
+    xyz2 = random_walk(Npts)
+    bvh1 = SphereBVH_double(xyz1, [], ids)
+    # scattered ids, through pickle so the id blocks are rebuilt on load
+    bvh2 = pickle.loads(pickle.dumps(SphereBVH_double(xyz2, [], np.random.permutation(ids))))
+    pos1 = hm.rand_xform(N, cart_sd=0.5)
+    pos2 = hm.rand_xform(N, cart_sd=0.5)
+    mask1 = np.random.rand(N, Nids) < 0.2
+    mask2 = (np.arange(Nids) % 40 < 8)[None]
+    maxdist = 0.1
+
+    pairs, lbub = wu.bvh_collect_pairs_mask_vec(bvh1, bvh2, pos1, pos2, maxdist, mask1, mask2)
+    allpairs, alllbub = wu.bvh_collect_pairs_vec(bvh1, bvh2, pos1, pos2, maxdist)
+    isect, clash = wu.bvh_isect_mask_vec(bvh1, bvh2, pos1, pos2, maxdist, mask1, mask2)
+    for i in range(N):
+        p = pairs[lbub[i, 0]:lbub[i, 1]]
+        ap = allpairs[alllbub[i, 0]:alllbub[i, 1]]
+        ap = ap[mask1[i, ap[:, 0]] & mask2[0, ap[:, 1]]]
+        assert set(map(tuple, p)) == set(map(tuple, ap))
+        assert len(p) == len(ap)
+        assert isect[i] == (len(ap) > 0)
+        if isect[i]:
+            assert mask1[i, clash[i, 0]] and mask2[0, clash[i, 1]]
+
+def test_bvh_sym_vec():
+    N, Npts, nsym = 20, 300, 6
+    xyz = np.random.rand(Npts, 3) - [0.5, 0.5, 0.5] + [1.0, 0, 0]
+    bvh = SphereBVH_double(xyz)
+    syms = np.stack([hm.hrot([0, 0, 1], k * 360.0 / nsym, degrees=True) for k in range(nsym)])
+    pos = hm.rand_xform(N, cart_sd=0.1)
+    pos[:, :3, :3] = np.stack([hm.hrot([0, 0, 1], a, degrees=True)[:3, :3] for a in np.random.rand(N) * 360])
+    mindist, maxdist = 0.03, 0.08
+
+    isect = wu.bvh_isect_sym_vec(bvh, pos, syms, mindist)
+    npair = wu.bvh_count_pairs_sym_vec(bvh, pos, syms, maxdist)
+    assert npair.shape == (N, nsym)
+    assert np.all(npair[:, 0] == 0)
+    for i in range(N):
+        copies = syms @ pos[i]
+        isect2 = wu.bvh_isect_vec(bvh, bvh, pos[i], copies[1:], mindist)
+        assert isect[i] == np.any(isect2)
+        npair2 = wu.bvh_count_pairs_vec(bvh, bvh, np.tile(pos[i], (nsym - 1, 1, 1)), copies[1:], maxdist)
+        assert np.all(npair[i, 1:] == npair2)
+
+def test_bvh_isect_range_warm():
+    N, Npts, Nids = 500, 1000, 100
+    ids = np.repeat(np.arange(Nids), Npts // Nids)
+    bvh1 = SphereBVH_double(random_walk(Npts), [], ids)
+    bvh2 = SphereBVH_double(random_walk(Npts), [], ids)
+    # a few random starts, each followed by a small local scan
+    pos1 = np.tile(np.eye(4), (N, 1, 1))
+    pos2 = np.repeat(hm.rand_xform(N // 50, cart_sd=0.3), 50, axis=0)
+    pos2[:, 0, 3] += np.tile(np.arange(50) * 0.002, N // 50)
+    mindist = 0.02
+    # nasym1 below the id count, with shuffled ids so bounding volume id
+    # ranges wrap around nasym1
+    bvh3 = SphereBVH_double(random_walk(Npts), [], np.random.permutation(ids))
+    for b1, nasym1 in [(bvh1, -1), (bvh1, 37), (bvh3, 37)]:
+        for maxtrim in (-1, 30):
+            lb, ub = wu.bvh_isect_range(b1, bvh2, pos1, pos2, mindist, maxtrim, nasym1=nasym1)
+            for nthread in (1, 4):
+                lb2, ub2, nexit, nseedexit = wu.bvh_isect_range_warm(b1, bvh2, pos1, pos2, mindist, maxtrim,
+                                                                     nasym1=nasym1, nthread=nthread)
+                assert np.all(lb == lb2) and np.all(ub == ub2)
+                assert nexit == np.sum(lb == -1)
+                assert 0 <= nseedexit <= nexit
+
+def test_bvh_slide_multi_vec():
+    N, D = 10, 7
+    bvh1 = SphereBVH_double(np.random.rand(300, 3) - [0.5, 0.5, 0.5])
+    bvh2 = SphereBVH_double(np.random.rand(300, 3) - [0.5, 0.5, 0.5])
+    pos1 = hm.rand_xform(N, cart_sd=0.5)
+    pos2 = hm.rand_xform(N, cart_sd=0.5)
+    dirns = np.random.randn(D, 3)
+    slides = wu.bvh_slide_multi_vec(bvh1, bvh2, pos1, pos2, 0.02, dirns)
+    assert slides.shape == (N, D)
+    for k in range(D):
+        assert np.allclose(slides[:, k], wu.bvh_slide_vec(bvh1, bvh2, pos1, pos2, 0.02, dirns[k]))
+
+def test_bvh_slide_rot():
+    rad, axis, cen = 0.02, np.array([0, 0, 1.0]), np.array([1.0, 0, 0])
+    xyz1 = np.random.rand(200, 3) - [0.5, 0.5, 0.5] + [2, 0, 0]
+    xyz2 = np.random.rand(200, 3) - [0.5, 0.5, 0.5]
+    bvh1 = SphereBVH_double(xyz1)
+    bvh2 = SphereBVH_double(xyz2)
+    pos1 = hm.htrans([0, 0, 0])
+    pos2 = hm.htrans([0, 0, 0])
+    ang = wu.bvh_slide_rot(bvh1, bvh2, pos1, pos2, rad, axis, cen)
+    assert 0 < ang < 2 * np.pi
+    rot = hm.hrot(axis, ang, cen, degrees=False)
+    d, i1, i2 = wu.bvh_min_dist(bvh1, bvh2, rot @ pos1, pos2)
+    assert np.allclose(d, 2 * rad, atol=1e-4)
+    d, i1, i2 = wu.bvh_min_dist(bvh1, bvh2, hm.hrot(axis, 0.99 * ang, cen, degrees=False) @ pos1, pos2)
+    assert d > 2 * rad
+
+    pos1 = hm.rand_xform(10, cart_sd=0.1)
+    angs = wu.bvh_slide_rot_vec(bvh1, bvh2, pos1, pos2, rad, axis, cen)
+    for p, a in zip(pos1, angs):
+        assert np.allclose(a, wu.bvh_slide_rot(bvh1, bvh2, p, pos2, rad, axis, cen))
+
+def test_bvh_collect_pairs_stream(tmpdir):
+    N = 50
+    bvh1 = SphereBVH_double(np.random.rand(1000, 3) - [0.5, 0.5, 0.5])
+    bvh2 = SphereBVH_double(np.random.rand(1000, 3) - [0.5, 0.5, 0.5])
+    pos1 = hm.rand_xform(N, cart_sd=0.3)
+    pos2 = hm.rand_xform(N, cart_sd=0.3)
+    maxdist = 0.05
+    pairs, lbub = wu.bvh_collect_pairs_vec(bvh1, bvh2, pos1, pos2, maxdist)
+
+    chunks = list(wu.bvh_collect_pairs_iter(bvh1, bvh2, pos1, pos2, maxdist, chunk=100))
+    assert len(chunks) > 1
+    assert np.all(np.concatenate([c[0] for c in chunks]) == pairs)
+    for p, lb, start in chunks:
+        assert len(p) >= 100 or start + len(lb) == N
+        assert np.all(np.diff(lb, axis=1) == np.diff(lbub[start:start + len(lb)], axis=1))
+
+    got = list()
+    total = wu.bvh_collect_pairs_chunked(bvh1, bvh2, pos1, pos2, maxdist, lambda p, lb, start: got.append(p),
+                                         chunk=100)
+    assert total == len(pairs)
+    assert np.all(np.concatenate(got) == pairs)
+
+    fname = str(tmpdir.join('pairs.npy'))
+    lbub2 = wu.bvh_collect_pairs_npy(bvh1, bvh2, pos1, pos2, maxdist, fname, chunk=100)
+    assert np.all(np.load(fname, mmap_mode='r') == pairs)
+    assert np.all(lbub2 == lbub)
+
+def test_bvh_collect_pairs_no_copy():
+    bvh1 = SphereBVH_double(np.random.rand(1000, 3) - [0.5, 0.5, 0.5])
+    bvh2 = SphereBVH_double(np.random.rand(1000, 3) - [0.5, 0.5, 0.5])
+    pos1 = hm.rand_xform(10, cart_sd=0.3)
+    pos2 = hm.rand_xform(10, cart_sd=0.3)
+    pairs, lbub = wu.bvh_collect_pairs_vec(bvh1, bvh2, pos1, pos2, 0.05)
+    # buffer is owned by a capsule, not a numpy copy
+    assert pairs.base is not None and not isinstance(pairs.base, np.ndarray)
+    assert pairs.dtype == np.int32 and pairs.flags.c_contiguous
+    assert pairs.shape == (lbub[-1, 1], 2)
+    buf = np.empty((100000, 2), dtype='i4')
+    for i in range(10):
+        p, o = wu.bvh_collect_pairs(bvh1, bvh2, pos1[i], pos2[i], 0.05, buf)
+        assert not o
+        assert set(map(tuple, p)) == set(map(tuple, pairs[lbub[i, 0]:lbub[i, 1]]))
+
+def test_bvh_create_views():
+    xyz = np.random.rand(1000, 3).astype('f4') - 0.5
+    ref = SphereBVH_double(xyz.astype('f8'))
+    for view in (xyz, np.asfortranarray(xyz), np.concatenate([xyz, xyz], 1)[:, :3]):
+        bvh = SphereBVH_double(view)
+        assert np.allclose(bvh.centers(), ref.centers())
+        assert np.all(bvh.vol_lb() == ref.vol_lb())
+    strided = np.random.rand(2000, 3) - 0.5
+    assert np.allclose(SphereBVH_double(strided[::2]).centers(), SphereBVH_double(strided[::2].copy()).centers())
+
+    mask = np.random.rand(1000) < 0.3
+    ids = np.arange(1000) // 3
+    bmask = SphereBVH_float(xyz, mask, ids)
+    bidx = SphereBVH_float(xyz, np.where(mask)[0], ids)
+    assert len(bmask) == np.sum(mask)
+    assert np.all(bmask.centers() == bidx.centers())
+    for empty in ([], np.array([], dtype='i4'), np.array([], dtype=bool)):
+        ball = SphereBVH_float(xyz, empty, ids)
+        assert len(ball) == len(xyz)
+        assert np.all(ball.obj_id() == SphereBVH_float(xyz, None, ids).obj_id())
+    assert np.all(bmask.obj_id() == bidx.obj_id())
+    try:
+        SphereBVH_float(xyz, [1000])
+        assert 0, 'index out of range should raise'
+    except RuntimeError:
+        pass
+
+def test_bvh_min_dist_eps():
+    bvh1 = SphereBVH_double(np.random.rand(2000, 3) - [0.5, 0.5, 0.5])
+    bvh2 = SphereBVH_double(np.random.rand(2000, 3) - [0.5, 0.5, 0.5])
+    pos1 = hm.rand_xform(100, cart_sd=0.6)
+    pos2 = hm.rand_xform(100, cart_sd=0.6)
+    exact, *_ = wu.bvh_min_dist_vec(bvh1, bvh2, pos1, pos2)
+    for eps in [0.01, 0.05]:
+        approx, i1, i2 = wu.bvh_min_dist_vec(bvh1, bvh2, pos1, pos2, eps=eps)
+        assert np.all(approx >= exact - 1e-9)
+        assert np.all(approx <= exact + eps + 1e-9)
+        d, *_ = wu.bvh_min_dist(bvh1, bvh2, pos1[0], pos2[0], eps=eps)
+        assert d == approx[0]
+
+def test_bvh_lazy():
+    xyz = np.random.rand(5000, 3) * 20 - 10
+    probe = SphereBVH_double(np.random.rand(100, 3) - 0.5)
+    full = SphereBVH_double(xyz)
+    lazy = wu.LazySphereBVH_double(xyz, levels=4)
+    assert len(lazy) == 5000
+    # four levels of nodes, the bottom one not yet split
+    assert lazy.nbuilt() == 15 and lazy.nexpanded() == 7
+    assert np.allclose(lazy.center(), full.center(), atol=1e-3)
+
+    pos1 = np.tile(np.eye(4), (100, 1, 1))
+    pos2 = hm.rand_xform(100, cart_sd=5)
+    d, i1, i2 = wu.bvh_min_dist_vec(full, probe, pos1, pos2)
+    dl, il1, il2 = wu.bvh_min_dist_vec(lazy, probe, pos1, pos2)
+    assert np.allclose(d, dl)
+    assert np.all(i1 == il1) and np.all(i2 == il2)
+    assert 15 < lazy.nbuilt() < 4999
+    assert np.all(wu.bvh_isect_vec(full, probe, pos1, pos2, 1.0) == wu.bvh_isect_vec(lazy, probe, pos1, pos2, 1.0))
+    pairs, lbub = wu.bvh_collect_pairs_vec(full, probe, pos1, pos2, 1.0)
+    lpairs, llbub = wu.bvh_collect_pairs_vec(lazy, probe, pos1, pos2, 1.0)
+    assert np.all(np.diff(lbub, axis=1) == np.diff(llbub, axis=1))
+    assert set(map(tuple, pairs)) == set(map(tuple, lpairs))
+    d2, *_ = wu.bvh_min_dist_vec(probe, lazy, pos2, pos1)
+    assert np.allclose(d, d2)
+
+    lazy.expand_all()
+    assert lazy.nbuilt() == 4999
+
+def test_bvh_dynamic():
+    probe = SphereBVH_double(np.random.rand(100, 3) - 0.5)
+    xyz = np.random.rand(3000, 3) * 10 - 5
+    ids = np.arange(3000) // 3
+    dyn = wu.DynamicSphereBVH_double(xyz[:1500], ids=ids[:1500])
+    dyn.insert(xyz[1500:], ids[1500:])
+    assert len(dyn) == 3000
+    assert dyn.check()
+    assert dyn.remove(np.arange(0, 1000, 2)) == 1500
+    assert dyn.remove([0, -1]) == 0
+    assert len(dyn) == 1500 and dyn.check()
+    keep = ids % 2 == 1
+    full = SphereBVH_double(xyz[keep], ids=ids[keep])
+    # insertion and rotations keep the tree about as tight as a full build
+    assert dyn.height() <= 2 * np.log2(len(dyn))
+    assert dyn.quality()['sumrad'] < 1.3 * full.quality()['sumrad']
+
+    pos1 = np.tile(np.eye(4), (50, 1, 1))
+    pos2 = hm.rand_xform(50, cart_sd=3)
+    d, i1, i2 = wu.bvh_min_dist_vec(full, probe, pos1, pos2)
+    dd, di1, di2 = wu.bvh_min_dist_vec(dyn, probe, pos1, pos2)
+    assert np.allclose(d, dd)
+    assert np.all(i1 == di1)
+    assert np.all(wu.bvh_count_pairs_vec(full, probe, pos1, pos2, 1.0) == wu.bvh_count_pairs_vec(dyn, probe, pos1, pos2, 1.0))
+    assert np.all(wu.bvh_isect_vec(probe, full, pos2, pos1, 0.5) == wu.bvh_isect_vec(probe, dyn, pos2, pos1, 0.5))
+
+    empty = wu.DynamicSphereBVH_float()
+    assert len(empty) == 0 and empty.height() == -1
+
+def point_seg_dist(p, a, b):
+    ab = b - a
+    t = np.clip(np.sum((p[:, None] - a) * ab, axis=-1) / np.sum(ab * ab, axis=-1), 0, 1)
+    return np.linalg.norm(a + t[..., None] * ab - p[:, None], axis=-1)
+
+def test_bvh_radius_objects():
+    xyz = np.random.rand(300, 3) * 6 - 3
+    rad = np.random.rand(300) * 0.3 + 0.1
+    sph = wu.SphereRadBVH_double(xyz, rad)
+    assert len(sph) == 300
+    assert np.allclose(np.sort(sph.obj_radius()), np.sort(rad))
+    ends = np.random.rand(100, 2, 3) * 6 - 3
+    cap = wu.CapsuleBVH_double(ends, np.array([0.2]), ids=np.arange(100) + 7)
+    assert np.all(np.sort(cap.obj_id()) == np.arange(100) + 7)
+
+    pos1 = np.tile(np.eye(4), (20, 1, 1))
+    pos2 = hm.rand_xform(20, cart_sd=2)
+    d, i1, i2 = wu.bvh_min_dist_vec(sph, cap, pos1, pos2)
+    count = wu.bvh_count_pairs_vec(sph, cap, pos1, pos2, 0.1)
+    for k in range(20):
+        e = ends @ pos2[k, :3, :3].T + pos2[k, :3, 3]
+        sd = point_seg_dist(xyz, e[:, 0], e[:, 1]) - rad[:, None] - 0.2
+        assert np.isclose(d[k], sd.min())
+        assert np.isclose(sd[i1[k], i2[k] - 7], d[k])
+        assert count[k] == np.sum(sd < 0.1)
+        assert wu.bvh_isect(sph, cap, pos1[k], pos2[k], 0.1) == (count[k] > 0)
+
+    # zero radius spheres act as points
+    pbvh = SphereBVH_double(xyz)
+    sph0 = wu.SphereRadBVH_double(xyz, np.zeros(1))
+    assert np.all(
+        wu.bvh_count_pairs_vec(pbvh, pbvh, pos1, pos2, 1.0) == wu.bvh_count_pairs_vec(sph0, sph0, pos1, pos2, 1.0))
+
+def test_bvh_permuted_id_bounds():
+    xyz = random_walk(1000)
+    ids = np.random.permutation(1000).astype('i4')
+    trees = [
+        SphereBVH_double(xyz, ids=ids),
+        SphereBVH_double(xyz, np.arange(1000), ids),
+        wu.SphereRadBVH_double(xyz, np.full(1, 0.01), ids=ids + 5),
+    ]
+    for bvh, lo in zip(trees, (0, 0, 5)):
+        lb, ub = bvh.vol_lb(), bvh.vol_ub()
+        assert np.all(lb <= ub)
+        assert lb.min() == lo and ub.max() == lo + 999
+        assert lb[-1] == lo and ub[-1] == lo + 999  # root is last
+
+    # the range prune is sound when ids don't follow the build order
+    bvh1, bvh2 = trees[0], SphereBVH_double(random_walk(1000))
+    pos1 = hm.rand_xform(20, cart_sd=0.3)
+    pos2 = hm.rand_xform(20, cart_sd=0.3)
+    for i in range(20):
+        r1 = wu.bvh_isect_range_single(bvh1=bvh1, bvh2=bvh2, pos1=pos1[i], pos2=pos2[i], mindist=0.02)
+        r2 = wu.naive_bvh_isect_range(bvh1, bvh2, pos1[i], pos2[i], 0.02)
+        assert r1 == r2
+
+def test_bvh_raycast():
+    xyz = np.random.rand(1000, 3) * 10 - 5
+    bvh = SphereBVH_double(xyz)
+    pose = hm.rand_xform(cart_sd=2)
+    rays = hm.hrandray((20, 10), sdev=4)
+    dist, idx = wu.bvh_raycast(bvh, rays, 0.3, pose, maxdist=8)
+    anyhit = wu.bvh_raycast_any(bvh, rays, 0.3, pose, maxdist=8)
+    assert dist.shape == idx.shape == anyhit.shape == (20, 10)
+    assert np.all(anyhit == (idx >= 0))
+    assert np.all(np.isinf(dist[idx < 0]))
+
+    pts = hm.hxform(pose, xyz)[:, :3]
+    orig, dirn = rays[..., :3, 0].reshape(-1, 3), rays[..., :3, 1].reshape(-1, 3)
+    t = np.sum((pts[None] - orig[:, None]) * dirn[:, None], axis=-1)
+    perp2 = np.sum((pts[None] - orig[:, None])**2, axis=-1) - t**2
+    ok = perp2 < 0.3**2
+    entry = np.maximum(0, t - np.sqrt(np.maximum(0, 0.09 - perp2)))
+    inside = np.sum((pts[None] - orig[:, None])**2, axis=-1) < 0.09
+    ok &= (t > 0) | inside
+    entry = np.where(ok, entry, np.inf)
+    entry[entry >= 8] = np.inf
+    assert np.allclose(dist.reshape(-1), entry.min(axis=1))
+    assert np.all(idx.reshape(-1)[np.isfinite(dist.reshape(-1))] == np.argmin(entry, axis=1)[np.isfinite(dist.reshape(-1))])
+
+def test_bvh_isect_bodies():
+    bvhs = [SphereBVH_double(np.random.rand(100, 3) * 4 - 2) for i in range(3)]
+    poses = hm.rand_xform(60, cart_sd=8)
+    bodies = [bvhs[i % 3] for i in range(60)]
+    pairs = wu.bvh_isect_bodies(bodies, poses, 0.5)
+    ref = [(i, j) for i in range(60) for j in range(i + 1, 60)
+           if wu.bvh_isect(bodies[i], bodies[j], poses[i], poses[j], 0.5)]
+    assert pairs.shape == (len(ref), 2)
+    assert np.all(pairs == np.array(ref).reshape(-1, 2))
+
+    pairs1 = wu.bvh_isect_bodies([bvhs[0]], poses, 0.5, nthread=2)
+    ref1 = [(i, j) for i in range(60) for j in range(i + 1, 60)
+            if wu.bvh_isect(bvhs[0], bvhs[0], poses[i], poses[j], 0.5)]
+    assert len(pairs1) == len(ref1)
+
+def test_bvh_dock():
+    bvh1 = SphereBVH_double(np.random.rand(200, 3) * 10 - 5)
+    bvh2 = SphereBVH_double(np.random.rand(150, 3) * 8 - 4)
+    oris = hm.rand_xform(40, cart_sd=1)
+    dirns = np.random.randn(4, 3)
+    stubs1, stubs2 = hm.rand_xform(200), hm.rand_xform(150)
+    xbin = wu.Xbin_double(1.0, 20.0, 512.0)
+    phmap = wu.PHMap_u8f8()
+
+    ref = list()
+    for i, ori in enumerate(oris):
+        for k, d in enumerate(dirns):
+            d = d / np.linalg.norm(d)
+            slide = wu.bvh_slide(bvh2, bvh1, ori, np.eye(4), 0.5, d)
+            if slide > 9e8: continue
+            pos = ori.copy()
+            pos[:3, 3] += slide * d
+            pairs, _ = wu.bvh_collect_pairs_vec(bvh1, bvh2, np.eye(4), pos, 2.0)
+            keys = wu.key_of_selected_pairs(xbin, pairs, stubs1, stubs2, np.eye(4), pos)
+            phmap[keys[keys % 3 == 0]] = (keys[keys % 3 == 0] % 100) / 10.0
+            ref.append((pos, pairs))
+    assert len(ref) > 10
+
+    nc = np.array([len(p) for _, p in ref])
+    score, ncontact, pos, iori, idir = wu.bvh_dock(bvh1, bvh2, oris, dirns, 0.5, 2.0, topk=10)
+    assert len(score) == 10
+    assert np.all(score == ncontact)
+    assert np.all(ncontact == -np.sort(-nc)[:10])
+    assert np.allclose(pos[:, :3, :3], oris[iori, :3, :3])
+
+    sc = np.array([
+        np.sum(wu.map_of_selected_pairs(xbin, phmap, p, stubs1, stubs2, np.eye(4), x)) for x, p in ref
+    ])
+    score, ncontact, pos, iori, idir = wu.bvh_dock(bvh1, bvh2, oris, dirns, 0.5, 2.0, topk=10, xbin=xbin,
+                                                   phmap=phmap, stubs1=stubs1, stubs2=stubs2)
+    assert np.allclose(score, -np.sort(-sc)[:10])
+
+def test_bvh_cache(tmpdir):
+    xyz = np.random.rand(2000, 3) - 0.5
+    ids = np.random.permutation(2000).astype('i4')
+    prev = wu.bvh_set_cache_dir(str(tmpdir))
+    try:
+        s0 = wu.bvh_cache_stats()
+        bvh1 = SphereBVH_double(xyz, ids=ids)
+        s1 = wu.bvh_cache_stats()
+        assert s1['misses'] == s0['misses'] + 1 and s1['writes'] == s0['writes'] + 1
+        assert len(tmpdir.listdir()) == 1
+        bvh2 = SphereBVH_double(np.asfortranarray(xyz), ids=ids)
+        s2 = wu.bvh_cache_stats()
+        assert s2['hits'] == s1['hits'] + 1
+        for a, b in zip(bvh1.__getstate__(), bvh2.__getstate__()):
+            assert np.all(a == b)
+        SphereBVH_double(xyz)
+        SphereBVH_float(xyz, ids=ids)
+        assert wu.bvh_cache_stats()['misses'] == s2['misses'] + 2
+        assert len(tmpdir.listdir()) == 3
+    finally:
+        wu.bvh_set_cache_dir(prev)
+    assert wu.bvh_cache_stats()['dir'] == prev
+
+def test_bvh_bound_method():
+    xyz = np.random.rand(3000, 3) - 0.5
+    pos = hm.rand_xform(20, cart_sd=0.3)
+    ref = SphereBVH_double(xyz)
+    npair = wu.bvh_count_pairs_vec(ref, ref, np.eye(4)[None].repeat(20, 0), pos, 0.05)
+    qref = ref.quality()
+    assert qref['nvol'] == 2999 and qref['maxdepth'] >= 12
+    for bound in 'merge ritter central'.split():
+        bvh = SphereBVH_double(xyz, bound=bound)
+        q = bvh.quality()
+        assert q['nvol'] == qref['nvol'] and q['maxdepth'] == qref['maxdepth']
+        assert q['sumrad'] >= qref['sumrad'] * 0.999
+        assert np.all(wu.bvh_count_pairs_vec(bvh, bvh, np.eye(4)[None].repeat(20, 0), pos, 0.05) == npair)
+    sph = wu.SphereRadBVH_double(xyz, np.full(3000, 0.01), bound='ritter')
+    assert sph.quality()['overlap'] > 0
+    try:
+        SphereBVH_double(xyz, bound='foo')
+        assert 0
+    except RuntimeError:
+        pass
+
 if __name__ == '__main__':
     test_collect_pairs_range_sym()
     test_bvh_isect_cpp()
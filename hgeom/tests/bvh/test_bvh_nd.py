@@ -3,8 +3,8 @@ import numpy as np
 
 import pytest
 
-pytest.importorskip('hgeom.bvh_nd')
-from hgeom.bvh_nd import *
+pytest.importorskip('hgeom._bvh_nd')
+from hgeom._bvh_nd import *
 
 
 def test_bvh_isect6():
@@ -110,6 +110,100 @@ def test_bvh_mindist7():
     print('nai', tnai)
 
 
+def test_bvh_nd_float_threads():
+    pts = np.random.rand(2000, 7)
+    samp = np.random.rand(5000, 7)
+    bvh64 = create_bvh7d(pts)
+    bvh32 = create_bvh7d(pts.astype('f4'))
+    assert isinstance(bvh32, SphereBVH7D_float)
+    d1, w1 = bvh_mindist7d(bvh64, samp, nthread=1)
+    d4, w4 = bvh_mindist7d(bvh64, samp, nthread=4)
+    assert np.all(d1 == d4) and np.all(w1 == w4)
+    d32, w32 = bvh_mindist7d(bvh32, samp.astype('f4'))
+    assert d32.dtype == np.float32
+    assert np.allclose(d32, d1, atol=1e-5)
+    isect = bvh_isect7d(bvh32, samp.astype('f4'), 0.2, nthread=4)
+    assert np.all((0 <= isect) == (0 <= bvh_isect7d(bvh64, samp, 0.2)))
+
+
+def test_bvh_nd_bound_method():
+    pts = np.random.randn(5000, 7)
+    samp = np.random.randn(500, 7)
+    exact = create_bvh7d(pts)
+    dist, w = bvh_mindist7d(exact, samp)
+    # enough points that the threaded build splits past 4096 more than once
+    big = np.random.randn(20000, 7)
+    for bound in ['ritter', 'merge']:
+        bvh = create_bvh7d(pts, bound=bound, nthread=4)
+        assert bvh.quality()['sumrad'] >= exact.quality()['sumrad'] * 0.999
+        d, w2 = bvh_mindist7d(bvh, samp)
+        assert np.allclose(d, dist) and np.all(w2 == w)
+        bvh4 = create_bvh7d(big, bound=bound, nthread=4)
+        bvh1 = create_bvh7d(big, bound=bound, nthread=1)
+        assert bvh4.quality() == bvh1.quality()
+        assert bvh4.radius() == bvh1.radius()
+        assert np.all(bvh4.center() == bvh1.center())
+
+
+def test_bvh_quat_double_cover():
+    quat = np.random.randn(3000, 4)
+    quat /= np.linalg.norm(quat, axis=1)[:, None]
+    xform = np.concatenate([quat, np.random.randn(3000, 3)], axis=1)
+    samp = xform[:1000] * [-1, -1, -1, -1, 1, 1, 1] + np.random.randn(1000, 7) * 0.01
+    samp = np.concatenate([samp, np.random.randn(1000, 7)])
+    bvh = create_bvh_xform(xform)
+    assert isinstance(bvh, XformBVH7D) and len(bvh) == 3000
+    assert np.all(bvh.centers()[:, 0] >= 0)
+    dist, w = bvh_mindist7d(bvh, samp)
+    dist2, w2 = bvh_mindist7d_naive(bvh, samp)
+    assert np.allclose(dist, dist2) and np.all(w == w2)
+    d = np.minimum(
+        np.linalg.norm(xform[w] - samp, axis=1),
+        np.linalg.norm(xform[w] * [-1, -1, -1, -1, 1, 1, 1] - samp, axis=1),
+    )
+    assert np.allclose(d, dist)
+    assert np.all(dist[:1000] < 0.1)
+    isect = bvh_isect7d(bvh, samp, 0.1)
+    assert np.all((0 <= isect) == (dist < 0.1))
+    assert np.all((0 <= isect) == (0 <= bvh_isect7d_naive(bvh, samp, 0.1)))
+    # a tree of flipped copies matches across the double cover
+    other = create_bvh_xform(samp[:1000])
+    assert bvh_isect7d(bvh, other, 0.1) and bvh_isect7d_naive(bvh, other, 0.1)
+    for mindis in np.arange(0.1, 2, 0.1):
+        rand = create_bvh_xform(np.random.randn(30, 7))
+        assert bvh_isect7d(bvh, rand, mindis) == bvh_isect7d_naive(bvh, rand, mindis)
+    bvh4 = create_bvh_quat(quat.astype('f4'))
+    assert isinstance(bvh4, QuatBVH4D_float)
+    d4, w4 = bvh_mindist4d(bvh4, -quat[:100].astype('f4'))
+    assert np.allclose(d4, 0, atol=1e-5) and np.all(w4 == np.arange(100))
+
+
+def test_bvh_nd_anydim_knn_radius():
+    for dim in (5, 11):
+        pts = np.random.randn(2000, dim)
+        samp = np.random.randn(300, dim)
+        bvh = create_bvh_nd(pts, nthread=4)
+        assert isinstance(bvh, SphereBVHX) and len(bvh) == 2000 and bvh.dim == dim
+        d2 = np.sum((samp[:, None] - pts[None]) ** 2, axis=2)
+        dist, w = bvh_knn(bvh, samp, 6, nthread=4)
+        assert np.all(w == np.argsort(d2, axis=1)[:, :6])
+        assert np.allclose(dist, np.sqrt(np.sort(d2, axis=1)[:, :6]))
+        r = np.sqrt(np.quantile(d2, 0.01))
+        pairs = bvh_radius(bvh, samp, r, nthread=4)
+        assert np.all(pairs == np.stack(np.nonzero(d2 <= r * r), axis=1))
+    bvh = create_bvh_nd(pts.astype('f4'), bound='ritter')
+    assert isinstance(bvh, SphereBVHX_float) and bvh.dim == 11
+    dist32, w32 = bvh_knn(bvh, samp.astype('f4'), 6)
+    assert np.allclose(dist32, dist, atol=1e-4)
+    dist, w = bvh_knn(create_bvh_nd(pts[:3]), samp, 5)
+    assert np.all(w[:, 3:] == -1) and np.all(np.isinf(dist[:, 3:]))
+    # the legacy 7D trees answer the same knn
+    pts7, samp7 = pts[:, :7].copy(), samp[:, :7].copy()
+    dist7, w7 = bvh_knn(create_bvh7d(pts7), samp7, 6)
+    distx, wx = bvh_knn(create_bvh_nd(pts7), samp7, 6)
+    assert np.all(w7 == wx) and np.allclose(dist7, distx)
+
+
 if __name__ == '__main__':
     # print(4096 / 2.9, 1000000 / 38.3)
     # test_bvh_isect7()
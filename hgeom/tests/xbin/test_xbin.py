@@ -132,11 +132,24 @@ def testpickle(tmpdir):
     assert np.all(xb[x] == xb2[x])
 
 
+def test_key_of_blocks():
+    for Xbin, dt in [(Xbin_double, 'f8'), (Xbin_float, 'f4')]:
+        xb = Xbin(0.3, 5.0, 256.0)
+        x = hm.rand_xform(10_000, cart_sd=30).astype(dt)
+        k = xb.key_of(x)
+        # ori_cell_of goes through the one at a time get_key
+        assert np.all(k >> 55 == xb.ori_cell_of(x))
+        for n in [0, 1, 31, 33, 257]:
+            assert np.all(xb.key_of(x[5:5 + n]) == k[5:5 + n])
+        assert np.all(xb.key_of(xb.bincen_of(k)) == k)
+
+
 if __name__ == '__main__':
     import tempfile
 
     test_xbin_cpp()
     test_key_of()
+    test_key_of_blocks()
     test_create_binner()
     test_xbin_covrad()
     test_xbin_covrad_ori()
@@ -104,6 +104,34 @@ def test_map_of_selected_pairs():
     assert np.all(vals == phm[keys])
 
 
+def test_map_of_selected_pairs_matches_key_of():
+    # key_of keys a block at a time, the map lookups one xform at a time. in
+    # the -Ofast build both must give the same keys, or a table filled from
+    # key_of misses lookups. x1 is the identity so both key the same xforms
+    N, M = 100000, 20000
+    for dtype, Xbin in [('f8', Xbin_double), ('f4', Xbin_float)]:
+        xb = Xbin(1.0, 15.0)
+        x = hm.rand_xform(N, cart_sd=100)
+        # rotations by multiples of 90 and translations on half cells sit on
+        # the cell and lattice boundaries
+        rot = np.zeros((M, 3, 3))
+        perm = np.argsort(np.random.rand(M, 3), axis=1)
+        rot[np.arange(M)[:, None], np.arange(3), perm] = np.random.choice([-1, 1], (M, 3))
+        rot[np.linalg.det(rot) < 0] *= -1
+        x[:M, :3, :3] = rot
+        x[:M, :3, 3] = np.random.randint(-8, 9, (M, 3)) * 0.5
+        x = x.astype(dtype)
+
+        keys = xb.key_of(x)
+        phm = wu.PHMap_u8f8()
+        phm[keys] = np.arange(N, dtype='f8')
+        phm.default = -1
+        idx = np.stack([np.zeros(N, dtype='i8'), np.arange(N)], axis=1)
+        vals = xu.map_of_selected_pairs(xb, phm, idx, np.eye(4, dtype=dtype)[None], x)
+        assert np.all(vals >= 0)
+        assert np.all(vals == phm[keys])
+
+
 def test_selected_pairs_pos():
     xb = Xbin_float()
     N = 1
@@ -125,4 +153,5 @@ if __name__ == '__main__':
     test_sskey_of_selected_pairs()
     test_ssmap_of_selected_pairs()
     test_map_of_selected_pairs()
+    test_map_of_selected_pairs_matches_key_of()
     test_selected_pairs_pos()
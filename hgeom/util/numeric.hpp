@@ -135,6 +135,21 @@ Eigen::Map<Eigen::Quaternion<F> const> hbt24_cellcen(Index const &i) {
   return QuatWrap(get_raw_48cell_half<F>() + 4 * i);
 }
 
+/// hbt24_cellcen(i).inverse() for the 24 cells, coeffs in Eigen's x,y,z,w
+/// order. computed by Eigen itself so batched code matches it to the bit
+template <typename F> static F const *get_raw_48cell_half_inverse() {
+  static F const *const inv = []() {
+    static F raw[24 * 4];
+    for (int i = 0; i < 24; ++i) {
+      Eigen::Quaternion<F> q = hbt24_cellcen<F>(i).inverse();
+      for (int j = 0; j < 4; ++j)
+        raw[4 * i + j] = q.coeffs()[j];
+    }
+    return raw;
+  }();
+  return inv;
+}
+
 template <int DIM, typename A> void clamp01(A &a) {
   for (int i = 0; i < DIM; ++i) {
     a[i] = fmin(1.0, fmax(0.0, a[i]));
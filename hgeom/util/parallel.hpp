@@ -0,0 +1,65 @@
+#pragma once
+/** \file */
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace hgeom {
+namespace util {
+
+/**
+ * @brief      number of threads to use for nwork items. nthread <= 0 means
+ * use std::thread::hardware_concurrency()
+ */
+inline int resolve_nthread(int nthread, size_t nwork) {
+  if (nthread <= 0) nthread = (int)std::thread::hardware_concurrency();
+  if (nthread <= 0) nthread = 1;
+  return (int)std::min<size_t>((size_t)nthread, std::max<size_t>(nwork, 1));
+}
+
+/**
+ * @brief      calls func(i) for i in [0, n), spread over nthread threads.
+ * work is handed out in chunks from a shared counter so uneven queries
+ * balance. func must be safe to call concurrently. the first exception thrown
+ * by any worker is rethrown in the calling thread. must be called without
+ * the GIL held if func does not touch python
+ */
+template <typename Func>
+void parallel_for(size_t n, Func func, int nthread = 0, size_t chunk = 0) {
+  nthread = resolve_nthread(nthread, n);
+  if (nthread == 1) {
+    for (size_t i = 0; i < n; ++i) func(i);
+    return;
+  }
+  if (chunk == 0) chunk = std::max<size_t>(1, n / (8 * nthread));
+  std::atomic<size_t> next(0);
+  std::exception_ptr err = nullptr;
+  std::mutex errmtx;
+  auto worker = [&]() {
+    try {
+      while (true) {
+        size_t lb = next.fetch_add(chunk);
+        if (lb >= n) break;
+        size_t ub = std::min(n, lb + chunk);
+        for (size_t i = lb; i < ub; ++i) func(i);
+      }
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(errmtx);
+      if (!err) err = std::current_exception();
+      next = n;
+    }
+  };
+  std::vector<std::thread> threads;
+  threads.reserve(nthread - 1);
+  for (int i = 0; i < nthread - 1; ++i) threads.emplace_back(worker);
+  worker();
+  for (auto &t : threads) t.join();
+  if (err) std::rethrow_exception(err);
+}
+
+} // namespace util
+} // namespace hgeom
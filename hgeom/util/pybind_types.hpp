@@ -58,15 +58,37 @@ auto xform_eigen_to_py(XformArray xform, int size = -1) {
     return pybind11::array_t<F>(buf);
 }
 
+/**
+ * @brief      hands xforms to numpy without a copy, the returned array's
+ * capsule takes ownership of *xform
+ */
 template <typename XformArray>
 auto xform_eigenptr_to_py(std::unique_ptr<XformArray> xform) {
     using Xform = typename XformArray::Scalar;
     using F = typename Xform::Scalar;
     F *data = (F *)xform->data();
-    std::vector<size_t> shape{xform->size(), 4, 4};
-    std::vector<size_t> stride{16 * sizeof(F), 4 * sizeof(F), sizeof(F)};
-    auto buf = pybind11::buffer_info(data, shape, stride);
-    return pybind11::array_t<F>(buf);
+    std::vector<pybind11::ssize_t> shape{(pybind11::ssize_t)xform->size(), 4,
+                                         4};
+    std::vector<pybind11::ssize_t> stride{16 * sizeof(F), 4 * sizeof(F),
+                                          sizeof(F)};
+    pybind11::capsule owner(xform.release(), [](void *p) {
+        delete reinterpret_cast<XformArray *>(p);
+    });
+    return pybind11::array_t<F>(shape, stride, data, owner);
+}
+
+/**
+ * @brief      views a std::vector as a numpy array of the given shape without
+ * a copy. the vector is moved to the heap and owned by the array's capsule
+ */
+template <typename T>
+pybind11::array_t<T> vector_to_py(std::vector<T> &&v,
+                                  std::vector<pybind11::ssize_t> shape) {
+    auto heap = new std::vector<T>(std::move(v));
+    pybind11::capsule owner(heap, [](void *p) {
+        delete reinterpret_cast<std::vector<T> *>(p);
+    });
+    return pybind11::array_t<T>(shape, heap->data(), owner);
 }
 
 inline void check_xform_array(pybind11::array a) {
@@ -5,7 +5,9 @@
 import os
 include = os.path.join(os.path.dirname(self.filename),'../..')
 cfg['include_dirs'] = [include, f'{include}/hgeom/extern']
-cfg['compiler_args'] = ['-std=c++17', '-w', '-Ofast']
+# IEEE math so get_keys matches get_key, see XformHash_bt24_BCC6::get_keys
+cfg['compiler_args'] = ['-std=c++17', '-w', '-O3', '-fno-math-errno',
+'-ffp-contract=off']
 cfg['dependencies'] = ['../geom/bcc.hpp','../util/assertions.hpp',
 '../util/global_rng.hpp', 'xbin.hpp', '../util/numeric.hpp',
 '../util/pybind_types.hpp']
@@ -56,7 +58,7 @@ py::array_t<F> _bincen_of(Xbin<F, K> const &binner, RefVx<K> keys) {
     for (int i = 0; i < keys.size(); ++i)
       (*out)[i] = binner.get_center(keys[i]);
   }
-  return xform_eigen_to_py(*out);
+  return xform_eigenptr_to_py(std::move(out));
 }
 
 template <typename K>
@@ -70,10 +72,7 @@ Vx<K> key_of(Xbin<F, K> const &binner, py::array_t<F> _xforms) {
   MapVxX3<F> xforms = xform_py_to_eigen(_xforms);
   py::gil_scoped_release release;
   Vx<K> out(xforms.size());
-  for (int i = 0; i < xforms.size(); ++i) {
-    K k = binner.get_key(xforms[i]);
-    out[i] = k;
-  }
+  binner.get_keys(xforms.data(), xforms.size(), out.data());
   return out;
 }
 template <typename F, typename K>
@@ -481,7 +480,7 @@ py::tuple xform_to_F6(Xbin<F, K> const &xbin, py::array_t<F> _xform) {
     for (int i = 0; i < xform.size(); ++i)
       f6->row(i) = xbin.xform_to_F6(xform[i], (*cell)[i]);
   }
-  return py::make_tuple(*f6, *cell);
+  return py::make_tuple(std::move(*f6), std::move(*cell));
 }
 
 template <typename F, typename K>
@@ -497,7 +496,7 @@ py::array_t<F> F6_to_xform(Xbin<F, K> const &xbin, Mx<F> f6, Vx<K> cell) {
     for (int i = 0; i < cell.size(); ++i)
       (*out)[i] = xbin.F6_to_xform(f6.row(i), cell[i]);
   }
-  return xform_eigen_to_py(*out);
+  return xform_eigenptr_to_py(std::move(out));
 }
 
 template <typename F, typename K>
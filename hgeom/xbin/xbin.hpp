@@ -21,6 +21,210 @@ using namespace util;
 
 // TODO: add bounds check angles version!
 
+// whether Eigen evaluates Vector4 sums and quaternion products on F with its
+// SIMD kernels, see Eigen/src/Geometry/arch/Geometry_SIMD.h. the batched key
+// code below follows whichever order Eigen uses, so it stays bit identical
+#if defined(EIGEN_VECTORIZE_SSE) ||                                          \
+    (defined(EIGEN_VECTORIZE_NEON) && EIGEN_ARCH_ARM64)
+template <typename F> constexpr bool eigen_simd_quat = true;
+#elif defined(EIGEN_VECTORIZE_NEON)
+template <typename F>
+constexpr bool eigen_simd_quat = std::is_same<F, float>::value;
+#else
+template <typename F> constexpr bool eigen_simd_quat = false;
+#endif
+
+/// a * b on (x,y,z,w) quaternions, term for term as Eigen's quat_product
+template <typename F>
+inline void quat_mul_as_eigen(F ax, F ay, F az, F aw, F bx, F by, F bz, F bw,
+                              F &x, F &y, F &z, F &w) {
+  if constexpr (eigen_simd_quat<F> && std::is_same<F, float>::value) {
+    x = (ax * bw - az * by) + (ay * bz + aw * bx);
+    y = (ay * bw - ax * bz) + (az * bx + aw * by);
+    z = (az * bw - ay * bx) + (ax * by + aw * bz);
+    w = (aw * bw - ax * bx) - (az * bz + ay * by);
+  } else if constexpr (eigen_simd_quat<F>) {
+    x = (aw * bx + ay * bz) - (az * by - ax * bw);
+    y = (aw * by + ay * bw) + (az * bx - ax * bz);
+    z = (aw * bz - ay * bx) + (az * bw + ax * by);
+    w = (aw * bw - ay * by) - (az * bz + ax * bx);
+  } else {
+    w = aw * bw - ax * bx - ay * by - az * bz;
+    x = aw * bx + ax * bw + ay * bz - az * by;
+    y = aw * by + ay * bw + az * bx - ax * bz;
+    z = aw * bz + az * bw + ax * by - ay * bx;
+  }
+}
+
+/* xform_to_F6 and BCC::get_index for B xforms whose rotation rows are
+   m[0..8] and translations p6[0..2]. each step runs as a loop across the
+   block, which the compiler vectorizes. the arms of each branch are computed
+   in one loop and picked in the next, as a select whose arms do float math
+   stays a branch under -ftrapping-math. so does one that leaves its array as
+   is. on return m[0..5] are the BCC cell coords, cell the 48cell_half cell
+   and odd the BCC sublattice */
+template <typename F, int B>
+void xform_bcc6_block(F (&m)[9][B], F (&p6)[6][B], F const *lower,
+                      F const *width, F const *inv, F (&cell)[B],
+                      F (&odd)[B]) {
+  constexpr F feps = std::numeric_limits<F>::epsilon();
+  constexpr F lowest = -std::numeric_limits<F>::max();
+  F const eps = std::sqrt(feps);
+  F const wscale = 2 * (std::sqrt(2.0) - 1);
+  double const hsqrt2 = std::sqrt(2.0) / 2;
+  F qx[B], qy[B], qz[B], qw[B];
+  // Quaternion(matrix). when the trace is not positive, i is the largest
+  // diagonal element, j = i+1 and k = i+2 (mod 3), q[i] = t1/2 and the
+  // other three are sums and differences across the diagonal, / 2 t1
+  F tr[B], dii[B], t0[B], t1[B], sx[B], sy[B], sz[B], sw[B];
+  for (int l = 0; l < B; ++l) {
+    F m00 = m[0][l], m01 = m[1][l], m02 = m[2][l];
+    F m10 = m[3][l], m11 = m[4][l], m12 = m[5][l];
+    F m20 = m[6][l], m21 = m[7][l], m22 = m[8][l];
+    bool i1 = m11 > m00;
+    bool i2 = m22 > (i1 ? m11 : m00);
+    F mii = i2 ? m22 : (i1 ? m11 : m00);
+    F mjj = i2 ? m00 : (i1 ? m22 : m11);
+    F mkk = i2 ? m11 : (i1 ? m00 : m22);
+    // q[j] is m(j,i) + m(i,j), q[k] is m(k,i) + m(i,k), w is m(k,j) -
+    // m(j,k). q[i] takes the place of the unused arm
+    F ax = i2 ? m02 : m01, bx = i2 ? m20 : m10;
+    F ay = i2 ? m12 : m10, by = i2 ? m21 : m01;
+    F az = i1 ? m21 : m20, bz = i1 ? m12 : m02;
+    F aw = i2 ? m10 : (i1 ? m02 : m21), bw = i2 ? m01 : (i1 ? m20 : m12);
+    tr[l] = m00 + (m11 + m22);
+    dii[l] = mii;
+    t0[l] = tr[l] + F(1.0);
+    t1[l] = mii - mjj - mkk + F(1.0);
+    sx[l] = ax + bx;
+    sy[l] = ay + by;
+    sz[l] = az + bz;
+    sw[l] = aw - bw;
+  }
+  // Eigen's packet sqrt is not the IEEE one under EIGEN_FAST_MATH
+  for (int l = 0; l < B; ++l) {
+    t0[l] = std::sqrt(t0[l]);
+    t1[l] = std::sqrt(t1[l]);
+  }
+  F w0[B], x0[B], y0[B], z0[B], hi[B];
+  for (int l = 0; l < B; ++l) {
+    F s0 = F(0.5) / t0[l], s1 = F(0.5) / t1[l];
+    w0[l] = F(0.5) * t0[l];
+    x0[l] = (m[7][l] - m[5][l]) * s0;
+    y0[l] = (m[2][l] - m[6][l]) * s0;
+    z0[l] = (m[3][l] - m[1][l]) * s0;
+    hi[l] = F(0.5) * t1[l];
+    sx[l] = sx[l] * s1;
+    sy[l] = sy[l] * s1;
+    sz[l] = sz[l] * s1;
+    sw[l] = sw[l] * s1;
+  }
+  // a diagonal element after i is never equal to m(i,i), only the ones
+  // before it are strictly smaller
+  F nx[B], ny[B], nz[B];
+  for (int l = 0; l < B; ++l) {
+    F d = dii[l], h = hi[l];
+    nx[l] = m[0][l] == d ? h : sx[l];
+    ny[l] = m[0][l] == d ? sy[l] : (m[4][l] == d ? h : sy[l]);
+    nz[l] = m[0][l] == d ? sz[l] : (m[4][l] == d ? sz[l] : h);
+  }
+  for (int l = 0; l < B; ++l) {
+    bool pos = tr[l] > F(0);
+    qw[l] = pos ? w0[l] : sw[l];
+    qx[l] = pos ? x0[l] : nx[l];
+    qy[l] = pos ? y0[l] : ny[l];
+    qz[l] = pos ? z0[l] : nz[l];
+  }
+
+  // get_cell_48cell_half. max2 is two argmax passes where the first max
+  // wins. cell numbers are held as F, to keep the loops single typed
+  F hd[B], ed[B], cd[B], h[B], e[B];
+  for (int l = 0; l < B; ++l) {
+    F a0 = std::abs(qx[l]), a1 = std::abs(qy[l]);
+    F a2 = std::abs(qz[l]), a3 = std::abs(qw[l]);
+    F i = 0, v1 = a0;
+    i = a1 > v1 ? F(1) : i, v1 = a1 > v1 ? a1 : v1;
+    i = a2 > v1 ? F(2) : i, v1 = a2 > v1 ? a2 : v1;
+    i = a3 > v1 ? F(3) : i, v1 = a3 > v1 ? a3 : v1;
+    F b0 = i == 0 ? lowest : a0, b1 = i == 1 ? lowest : a1;
+    F b2 = i == 2 ? lowest : a2, b3 = i == 3 ? lowest : a3;
+    F j = 0, v2 = b0;
+    j = b1 > v2 ? F(1) : j, v2 = b1 > v2 ? b1 : v2;
+    j = b2 > v2 ? F(2) : j, v2 = b2 > v2 ? b2 : v2;
+    j = b3 > v2 ? F(3) : j, v2 = b3 > v2 ? b3 : v2;
+    hd[l] = v1;
+    ed[l] = hsqrt2 * (v1 + v2);
+    cd[l] = (eigen_simd_quat<F> ? (a0 + a2) + (a1 + a3)
+                                : (a0 + a1) + (a2 + a3)) /
+            2;
+    h[l] = i;
+    e[l] = j;
+  }
+  F corner[B], edge[B];
+  for (int l = 0; l < B; ++l) {
+    F q0 = qx[l], q1 = qy[l], q2 = qz[l], q3 = qw[l];
+    F e1 = h[l] < e[l] ? h[l] : e[l], e2 = h[l] < e[l] ? e[l] : h[l];
+    F bits = (q0 < 0 ? F(1) : F(0)) + (q1 < 0 ? F(2) : F(0)) +
+             (q2 < 0 ? F(4) : F(0));
+    corner[l] = (q3 > 0 ? F(4) : F(11)) + (q3 > 0 ? bits : -bits);
+    // sign_shift + perm_shift[e1][e2]
+    F c1 = e1 == 0 ? q0 : (e1 == 1 ? q1 : q2);
+    F c2 = e2 == 1 ? q1 : (e2 == 2 ? q2 : q3);
+    F sign_shift = (c1 < 0) == (c2 < 0) ? F(0) : F(6);
+    F perm_shift = e1 + e2 - 1 + (e1 == 0 ? F(0) : F(1));
+    edge[l] = sign_shift + perm_shift + 12;
+  }
+  for (int l = 0; l < B; ++l)
+    cell[l] = hd[l] > cd[l] ? (hd[l] > ed[l] ? h[l] : edge[l])
+                            : (cd[l] > ed[l] ? corner[l] : edge[l]);
+
+  // hbt24_cellcen(cell).inverse() * q, to_half_cell, cube params
+  F ix[B], iy[B], iz[B], iw[B];
+  for (int l = 0; l < B; ++l) {
+    F const *ic = inv + 4 * (int)cell[l];
+    ix[l] = ic[0], iy[l] = ic[1], iz[l] = ic[2], iw[l] = ic[3];
+  }
+  F rx[B], ry[B], rz[B], rw[B];
+  for (int l = 0; l < B; ++l)
+    quat_mul_as_eigen(ix[l], iy[l], iz[l], iw[l], qx[l], qy[l], qz[l],
+                      qw[l], rx[l], ry[l], rz[l], rw[l]);
+  for (int l = 0; l < B; ++l) {
+    F x = rx[l], y = ry[l], z = rz[l], w = rw[l];
+    // to_half_cell negates unless w, x or y > eps or z > 0
+    F keep = (w > eps ? F(1) : F(0)) + (x > eps ? F(1) : F(0)) +
+             (y > eps ? F(1) : F(0)) + (z > 0 ? F(1) : F(0));
+    F sign = keep > 0 ? F(1) : F(-1);
+    F a = sign * x / (sign * w) / wscale + 0.5;
+    F b = sign * y / (sign * w) / wscale + 0.5;
+    F c = sign * z / (sign * w) / wscale + 0.5;
+    // fmin(1, fmax(0, a)), fmax takes nan to 0
+    p6[3][l] = a > 0 ? (a < 1 ? a : F(1)) : F(0);
+    p6[4][l] = b > 0 ? (b < 1 ? b : F(1)) : F(0);
+    p6[5][l] = c > 0 ? (c < 1 ? c : F(1)) : F(0);
+  }
+
+  // BCC::get_index. the indices go through int, which converts in
+  // vector registers and is the same as K for any in bounds value
+  F ind[6][B];
+  for (int d = 0; d < 6; ++d) {
+    for (int l = 0; l < B; ++l) {
+      F v = (p6[d][l] - lower[d]) / width[d];
+      ind[d][l] = (F)(int)v;
+      p6[d][l] = v - ind[d][l] - F(0.5);
+    }
+  }
+  for (int l = 0; l < B; ++l) {
+    F sum = (std::abs(p6[0][l]) +
+             (std::abs(p6[1][l]) + std::abs(p6[2][l]))) +
+            (std::abs(p6[3][l]) +
+             (std::abs(p6[4][l]) + std::abs(p6[5][l])));
+    odd[l] = 0.25 * 6 < std::abs(sum) ? F(1) : F(0);
+  }
+  for (int d = 0; d < 6; ++d)
+    for (int l = 0; l < B; ++l)
+      m[d][l] = ind[d][l] - (p6[d][l] < 0 ? F(1) : F(0)) * odd[l];
+}
+
 template <typename _Xform, typename _K = uint64_t> struct XformHash_bt24_BCC6 {
   const _K GRID_KEY_BITS = 55;
   const _K EMPTY_BITS = 4;
@@ -135,15 +339,60 @@ template <typename _Xform, typename _K = uint64_t> struct XformHash_bt24_BCC6 {
   K get_key(Xform x) const {
     K cell_index;
     F6 p6 = xform_to_F6(x, cell_index);
-#ifdef NDEBUG
-#undef NDEBUG
-    assert((grid6_[p6] >> GRID_KEY_BITS) == 0);
-#define NDEBUG
+    K grid = grid6_[p6];
+    check_grid_key(grid);
+    return combine_cell_grid_index(cell_index, grid);
+  }
+  /* get_key of n xforms. the block kernel matches get_key bit for bit only
+     under IEEE math, which the xbin targets pin (no fast math, no fp
+     contraction), so under fast math this is get_key in a loop */
+  void get_keys(Xform const *xforms, size_t n, K *out) const {
+#ifdef __FAST_MATH__
+    for (size_t i = 0; i < n; ++i)
+      out[i] = get_key(xforms[i]);
 #else
-    assert((grid6_[p6] >> GRID_KEY_BITS) == 0);
+    get_keys_block<32>(xforms, n, out);
 #endif
-
-    return combine_cell_grid_index(cell_index, grid6_[p6]);
+  }
+  // loads B xforms at a time into coordinate-major arrays for
+  // xform_bcc6_block
+  template <int B>
+  void get_keys_block(Xform const *xforms, size_t n, K *out) const {
+    F const *inv = get_raw_48cell_half_inverse<F>();
+    F lower[6], width[6];
+    for (int d = 0; d < 6; ++d) {
+      lower[d] = grid6_.lower_[d];
+      width[d] = grid6_.width_[d];
+    }
+    for (size_t beg = 0; beg < n; beg += B) {
+      int nb = std::min<size_t>(B, n - beg);
+      F m[9][B], p6[6][B], cell[B], odd[B];
+      for (int l = 0; l < B; ++l) {
+        Xform const &x = xforms[beg + (l < nb ? l : 0)];
+        for (int i = 0; i < 3; ++i) {
+          for (int j = 0; j < 3; ++j)
+            m[3 * i + j][l] = x.linear()(i, j);
+          p6[i][l] = x.translation()[i];
+        }
+      }
+      xform_bcc6_block<F, B>(m, p6, lower, width, inv, cell, odd);
+      // the coords go through int, which converts in vector registers and is
+      // the same as K for any in bounds value
+      for (int l = 0; l < nb; ++l) {
+        K index = 0;
+        for (int d = 0; d < 6; ++d)
+          index += grid6_.nside_prefsum_[d] * (K)(int)m[d][l];
+        K grid = (index << 1) + (K)odd[l];
+        check_grid_key(grid);
+        out[beg + l] = combine_cell_grid_index((K)cell[l], grid);
+      }
+    }
+  }
+  // checked in every build, a grid key that spills into the cell bits
+  // would alias a key in another cell
+  void check_grid_key(K grid) const {
+    if (bad_grid_key(grid))
+      throw std::out_of_range("grid key overflows GRID_KEY_BITS");
   }
   bool bad_grid_key(K k) const { return 0 < (k >> GRID_KEY_BITS); }
   bool bad_cell_index(K k) const { return k > 23; }
@@ -3,7 +3,7 @@
 import os
 include = os.path.join(os.path.dirname(self.filename),'../..')
 cfg['include_dirs'] = [include, f'{include}/hgeom/extern']
-cfg['compiler_args'] = ['-std=c++17', '-w']
+cfg['compiler_args'] = ['-std=c++17', '-w', '-ffp-contract=off']
 cfg['dependencies'] = ['xbin.hpp', '../util/assertions.hpp',
 '../util/global_rng.hpp']
 cfg['parallel'] = True
@@ -173,9 +173,54 @@ bool TEST_XformHash_XformHash_bt24_BCC6() {
   return pass;
 }
 
+bool TEST_XformHash_bt24_BCC6_get_keys() {
+  std::mt19937 rng((unsigned int)time(0) + 2384);
+  XformHash_bt24_BCC6<Xform> xh(1.0, 15.0, 512.0);
+  int const N = 10 * 1000;
+  std::vector<Xform> samples(N);
+  for (int i = 0; i < N; ++i)
+    rand_xform(rng, samples[i], 512.0);
+  // rotations by multiples of 90 and translations on half cells sit on the
+  // cell and lattice boundaries, where ties have to break the same way
+  std::uniform_int_distribution<int> rint(-8, 8);
+  for (int i = 0; i < N / 10; ++i) {
+    Eigen::Matrix3d r = Eigen::Matrix3d::Zero();
+    int perm = rint(rng) & 1 ? 1 : 2;
+    for (int k = 0; k < 3; ++k)
+      r(k, (k * perm + i) % 3) = rint(rng) < 0 ? -1 : 1;
+    samples[i].linear() = r.determinant() > 0 ? r : Eigen::Matrix3d(-r);
+    for (int k = 0; k < 3; ++k)
+      samples[i].translation()[k] = rint(rng) * xh.cart_resl_ / 2;
+  }
+
+  std::vector<uint64_t> keys1(N), keysn(N);
+  for (int i = 0; i < N; ++i)
+    keys1[i] = xh.get_key(samples[i]);
+  xh.get_keys(samples.data(), N, keysn.data());
+  for (int i = 0; i < N; ++i)
+    ASSERT_EQ(keys1[i], keysn[i]);
+  for (int n : {0, 1, 31, 33}) {
+    std::vector<uint64_t> keys(n + 1, 7);
+    xh.get_keys(samples.data() + 5, n, keys.data());
+    for (int i = 0; i < n; ++i)
+      ASSERT_EQ(keys[i], keys1[i + 5]);
+    ASSERT_EQ(keys[n], 7);
+  }
+  bool threw = false;
+  try {
+    xh.check_grid_key(uint64_t(1) << 60);
+  } catch (std::out_of_range const &) {
+    threw = true;
+  }
+  ASSERT_TRUE(threw);
+  return true;
+}
+
 PYBIND11_MODULE(xbin_test, m) {
   m.def("TEST_XformHash_XformHash_bt24_BCC6",
         &TEST_XformHash_XformHash_bt24_BCC6);
+  m.def("TEST_XformHash_bt24_BCC6_get_keys",
+        &TEST_XformHash_bt24_BCC6_get_keys);
 }
 
 } // namespace test
@@ -3,7 +3,9 @@
 import os
 include = os.path.join(os.path.dirname(self.filename),'../..')
 cfg['include_dirs'] = [include, f'{include}/hgeom/extern']
-cfg['compiler_args'] = ['-std=c++17', '-w', '-Ofast']
+# IEEE math so get_keys matches get_key, see XformHash_bt24_BCC6::get_keys
+cfg['compiler_args'] = ['-std=c++17', '-w', '-O3', '-fno-math-errno',
+'-ffp-contract=off']
 cfg['dependencies'] = ['../geom/bcc.hpp','../util/assertions.hpp',
 '../util/global_rng.hpp', 'xbin.hpp', '../util/numeric.hpp',
 '../util/pybind_types.hpp']
@@ -43,6 +45,20 @@ using namespace phmap;
 using namespace util;
 template <typename F, typename K> using Xbin = XformHash_bt24_BCC6<X3<F>, K>;
 
+/* keys of rel(i) for i in [0, n). the relative xforms are made a block at a
+   time into a buffer for get_keys */
+template <typename F, typename K, typename Rel>
+void keys_of_rel(Xbin<F, K> const &xb, size_t n, K *out, Rel rel) {
+  constexpr int B = 256;
+  X3<F> buf[B];
+  for (size_t beg = 0; beg < n; beg += B) {
+    int nb = std::min<size_t>(B, n - beg);
+    for (int l = 0; l < nb; ++l)
+      buf[l] = rel(beg + l);
+    xb.get_keys(buf, nb, out + beg);
+  }
+}
+
 template <typename I, typename F, typename K>
 Vx<K> kop_impl(Xbin<F, K> const &xb, py::array_t<I> p, py::array_t<F> x1,
                py::array_t<F> x2, M4<F> p1, M4<F> p2) noexcept {
@@ -52,11 +68,11 @@ Vx<K> kop_impl(Xbin<F, K> const &xb, py::array_t<I> p, py::array_t<F> x1,
   py::gil_scoped_release release;
   X3<F> x21 = X3<F>(p1).inverse() * X3<F>(p2);
   Vx<K> keys(p.shape()[0]);
-  for (int ip = 0; ip < keys.size(); ++ip) {
+  keys_of_rel(xb, keys.size(), keys.data(), [&](size_t ip) {
     I i1 = pp[2 * ip + 0];
     I i2 = pp[2 * ip + 1];
-    keys[ip] = xb.get_key(px1[i1].inverse() * (x21 * px2[i2]));
-  }
+    return X3<F>(px1[i1].inverse() * (x21 * px2[i2]));
+  });
   return keys;
 }
 
@@ -99,9 +115,9 @@ Vx<K> kop2_impl(Xbin<F, K> const &xb, py::array_t<I> i1, py::array_t<I> i2,
   py::gil_scoped_release release;
   X3<F> x21 = X3<F>(p1).inverse() * X3<F>(p2);
   Vx<K> keys(i1.shape()[0]);
-  for (int i = 0; i < keys.size(); ++i) {
-    keys[i] = xb.get_key(px1[i1p[i]].inverse() * (x21 * px2[i2p[i]]));
-  }
+  keys_of_rel(xb, keys.size(), keys.data(), [&](size_t i) {
+    return X3<F>(px1[i1p[i]].inverse() * (x21 * px2[i2p[i]]));
+  });
 
   return keys;
 }
@@ -158,9 +174,9 @@ Vx<K> kop2_onearray_impl(Xbin<F, K> const &xb, py::array_t<I> _idx,
   py::gil_scoped_release release;
   X3<F> x21 = X3<F>(p1).inverse() * X3<F>(p2);
   Vx<K> keys(idx.rows());
-  for (int i = 0; i < keys.size(); ++i) {
-    keys[i] = xb.get_key(px1[idx(i, 0)].inverse() * (x21 * px2[idx(i, 1)]));
-  }
+  keys_of_rel(xb, keys.size(), keys.data(), [&](size_t i) {
+    return X3<F>(px1[idx(i, 0)].inverse() * (x21 * px2[idx(i, 1)]));
+  });
   return keys;
 }
 
@@ -211,10 +227,11 @@ Vx<K> kop2ss_impl(Xbin<F, K> const &xb, py::array_t<I> i1, py::array_t<I> i2,
   py::gil_scoped_release release;
   X3<F> x21 = X3<F>(p1).inverse() * X3<F>(p2);
   Vx<K> keys(i1.shape()[0]);
-  for (int i = 0; i < keys.size(); ++i) {
-    K k = xb.get_key(x1p[i1p[i]].inverse() * (x21 * x2p[i2p[i]]));
-    keys[i] = k | ((K)ss1p[i1p[i]] << 62) | ((K)ss2p[i2p[i]] << 60);
-  }
+  keys_of_rel(xb, keys.size(), keys.data(), [&](size_t i) {
+    return X3<F>(x1p[i1p[i]].inverse() * (x21 * x2p[i2p[i]]));
+  });
+  for (int i = 0; i < keys.size(); ++i)
+    keys[i] |= ((K)ss1p[i1p[i]] << 62) | ((K)ss2p[i2p[i]] << 60);
   return keys;
 }
 
@@ -270,11 +287,11 @@ Vx<K> kop3ss_impl(Xbin<F, K> const &xb, py::array_t<I> idx, py::array_t<I> ss1,
   py::gil_scoped_release release;
   X3<F> x21 = X3<F>(p1).inverse() * X3<F>(p2);
   Vx<K> keys(idx.shape()[0]);
-  for (int i = 0; i < keys.size(); ++i) {
-    K k = xb.get_key(x1p[idxp[2 * i]].inverse() * (x21 * x2p[idxp[2 * i + 1]]));
-    k |= ((K)ss1p[idxp[2 * i]] << 62) | ((K)ss2p[idxp[2 * i + 1]] << 60);
-    keys[i] = k;
-  }
+  keys_of_rel(xb, keys.size(), keys.data(), [&](size_t i) {
+    return X3<F>(x1p[idxp[2 * i]].inverse() * (x21 * x2p[idxp[2 * i + 1]]));
+  });
+  for (int i = 0; i < keys.size(); ++i)
+    keys[i] |= ((K)ss1p[idxp[2 * i]] << 62) | ((K)ss2p[idxp[2 * i + 1]] << 60);
   return keys;
 }
 